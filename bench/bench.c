@@ -0,0 +1,284 @@
+#include "../src/arena.c"
+#include "../src/ast.c"
+#include "../src/codegen.c"
+#include "../src/emit.c"
+#include "../src/intern.c"
+#include "../src/lexer.c"
+#include "../src/optimizer.c"
+#include "../src/parser.c"
+#include "../src/scan.c"
+#include "../src/source.c"
+#include "../src/timer.c"
+#include "../src/tokens.c"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Measures the throughput of the compiler's front end and codegen.
+// Usage: bench [options] <file.fl>
+
+#define BENCH_MAX_PHASES 8
+
+// Throughput of one phase, measured as the best of all iterations.
+typedef struct {
+  const char *name;
+  double best_seconds;
+  double mb_per_second;
+  double lines_per_second;
+} PhaseResult;
+
+// Benchmark Defination
+typedef struct {
+  SourceFile source;
+  size_t lines;
+  unsigned iterations;
+  PhaseResult phases[BENCH_MAX_PHASES];
+  size_t phase_count;
+} Bench;
+
+// Helper function to record the timing of one iteration of a phase.
+void record(Bench *bench, const char *name, double seconds) {
+  PhaseResult *result = NULL;
+  for (size_t i = 0; i < bench->phase_count; i++) {
+    if (strcmp(bench->phases[i].name, name) == 0) {
+      result = &bench->phases[i];
+    }
+  }
+
+  if (!result) {
+    result = &bench->phases[bench->phase_count++];
+    result->name = name;
+    result->best_seconds = seconds;
+  } else if (seconds < result->best_seconds) {
+    result->best_seconds = seconds;
+  }
+
+  double megabytes = (double)bench->source.size / (1024.0 * 1024.0);
+  result->mb_per_second = megabytes / result->best_seconds;
+  result->lines_per_second = (double)bench->lines / result->best_seconds;
+}
+
+// Helper function to run the lexer over the whole file.
+void bench_lexer(Bench *bench) {
+  double start = read_clock(CLOCK_MONOTONIC);
+
+  Lexer lexer;
+  lexer_init(&lexer, bench->source.contents);
+  size_t tokens = 0;
+  while (compute_next_token(&lexer).kind != TOKEN_EOF) {
+    tokens++;
+  }
+
+  record(bench, "lex", read_clock(CLOCK_MONOTONIC) - start);
+  if (tokens == 0) {
+    fprintf(stderr, "Error: The benchmark input has no tokens.\n");
+    exit(1);
+  }
+}
+
+// Helper function to parse the whole file into a tree.
+void parse_source(Bench *bench, Ast *ast) {
+  Lexer lexer;
+  lexer_init(&lexer, bench->source.contents);
+  ast_init(ast, bench->source.contents, bench->source.size);
+  Parser parser;
+  parser_init(&parser, &lexer, ast);
+  parse_translation_unit(&parser);
+  parser_free(&parser);
+}
+
+// Helper function to time the parser (including on-demand lexing).
+void bench_parser(Bench *bench) {
+  Ast ast;
+
+  double start = read_clock(CLOCK_MONOTONIC);
+  parse_source(bench, &ast);
+  record(bench, "parse", read_clock(CLOCK_MONOTONIC) - start);
+
+  ast_free(&ast);
+}
+
+// Helper function to time lexing into a token buffer and parsing from it.
+void bench_pretokenized(Bench *bench) {
+  Ast ast;
+
+  double start = read_clock(CLOCK_MONOTONIC);
+  Lexer lexer;
+  lexer_init(&lexer, bench->source.contents);
+  ast_init(&ast, bench->source.contents, bench->source.size);
+  token_buffer_fill(&ast.tokens, &lexer);
+  record(bench, "tokenize", read_clock(CLOCK_MONOTONIC) - start);
+
+  start = read_clock(CLOCK_MONOTONIC);
+  Parser parser;
+  parser_init_tokens(&parser, &ast);
+  parse_translation_unit(&parser);
+  parser_free(&parser);
+  record(bench, "parse-tb", read_clock(CLOCK_MONOTONIC) - start);
+
+  ast_free(&ast);
+}
+
+// Helper function to time codegen over an already parsed program.
+void bench_codegen(Bench *bench, const Ast *ast) {
+  CodegenStats stats = {0};
+  LLVMContextRef llvm_context = LLVMContextCreate();
+
+  double start = read_clock(CLOCK_MONOTONIC);
+  LLVMModuleRef llvm_module = codegen(ast, 1, llvm_context, &stats);
+  record(bench, "codegen", read_clock(CLOCK_MONOTONIC) - start);
+
+  LLVMDisposeModule(llvm_module);
+  LLVMContextDispose(llvm_context);
+}
+
+// Helper function to compare the results against a stored baseline.
+// Returns the number of phases slower than the tolerance allows.
+int compare_baseline(const Bench *bench, const char *path, double tolerance) {
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    fprintf(stderr, "Could not open baseline at: %s\n", path);
+    exit(1);
+  }
+
+  int regressions = 0;
+  char line[256];
+  while (fgets(line, sizeof(line), file)) {
+    char name[64];
+    double baseline = 0;
+    if (line[0] == '#' || sscanf(line, "%63s %lf", name, &baseline) != 2) {
+      continue;
+    }
+
+    for (size_t i = 0; i < bench->phase_count; i++) {
+      const PhaseResult *result = &bench->phases[i];
+      if (strcmp(result->name, name) != 0) {
+        continue;
+      }
+
+      double change = (result->mb_per_second - baseline) / baseline * 100.0;
+      bool regressed = result->mb_per_second < baseline * (1.0 - tolerance);
+      printf("%-8s %10.2f MB/s vs baseline %10.2f MB/s (%+6.1f%%)%s\n", name,
+             result->mb_per_second, baseline, change,
+             regressed ? "  <-- REGRESSION" : "");
+      regressions += regressed;
+    }
+  }
+
+  fclose(file);
+  return regressions;
+}
+
+// Helper function to store the results as the new baseline.
+void write_baseline(const Bench *bench, const char *path) {
+  FILE *file = fopen(path, "w");
+  if (!file) {
+    fprintf(stderr, "Could not open baseline at: %s\n", path);
+    exit(1);
+  }
+
+  fprintf(file, "# Throughput baseline in MB/s, written by "
+                "'make bench-baseline'.\n");
+  for (size_t i = 0; i < bench->phase_count; i++) {
+    fprintf(file, "%s %.2f\n", bench->phases[i].name,
+            bench->phases[i].mb_per_second);
+  }
+  fclose(file);
+}
+
+int main(int argc, char **argv) {
+  Bench bench = {.iterations = 5};
+  const char *baseline_path = NULL;
+  bool update_baseline = false;
+  bool lex_only = false;
+  bool pretokenize = false;
+  double tolerance = 0.15;
+  const char *input_path = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+      bench.iterations = (unsigned)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+      tolerance = atof(argv[++i]) / 100.0;
+    } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+      baseline_path = argv[++i];
+    } else if (strcmp(argv[i], "--update-baseline") == 0 && i + 1 < argc) {
+      baseline_path = argv[++i];
+      update_baseline = true;
+    } else if (strcmp(argv[i], "--lex-only") == 0) {
+      lex_only = true;
+    } else if (strcmp(argv[i], "--pretokenize") == 0) {
+      pretokenize = true;
+    } else if (argv[i][0] != '-' && !input_path) {
+      input_path = argv[i];
+    } else {
+      fprintf(stderr, "Unknown option: %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  if (!input_path || bench.iterations == 0) {
+    fprintf(stderr,
+            "Usage: %s [--iterations N] [--tolerance PERCENT] [--lex-only] "
+            "[--pretokenize] "
+            "[--baseline FILE | --update-baseline FILE] <file.fl>\n",
+            argv[0]);
+    return 1;
+  }
+
+  intern_init();
+  source_open(&bench.source, input_path);
+  for (size_t i = 0; i < bench.source.size; i++) {
+    bench.lines += bench.source.contents[i] == '\n';
+  }
+
+  // Codegen always runs over the same tree.
+  Ast ast = {0};
+  if (!lex_only) {
+    parse_source(&bench, &ast);
+  }
+
+  for (unsigned i = 0; i < bench.iterations; i++) {
+    bench_lexer(&bench);
+    if (lex_only) {
+      continue;
+    }
+    bench_parser(&bench);
+    if (pretokenize) {
+      bench_pretokenized(&bench);
+    }
+    bench_codegen(&bench, &ast);
+  }
+
+  printf("%s: %zu lines, %.2f MB, best of %u\n", input_path, bench.lines,
+         (double)bench.source.size / (1024.0 * 1024.0), bench.iterations);
+  printf("%-8s %12s %12s %14s\n", "phase", "time (ms)", "MB/s", "lines/s");
+  for (size_t i = 0; i < bench.phase_count; i++) {
+    const PhaseResult *result = &bench.phases[i];
+    printf("%-8s %12.3f %12.2f %14.0f\n", result->name,
+           result->best_seconds * 1e3, result->mb_per_second,
+           result->lines_per_second);
+  }
+
+  int regressions = 0;
+  if (baseline_path && update_baseline) {
+    write_baseline(&bench, baseline_path);
+    printf("Baseline written to %s\n", baseline_path);
+  } else if (baseline_path) {
+    regressions = compare_baseline(&bench, baseline_path, tolerance);
+  }
+
+  ast_free(&ast);
+  source_close(&bench.source);
+  intern_free();
+
+  if (regressions > 0) {
+    fprintf(stderr,
+            "FAILED: %d phase(s) regressed by more than %.0f%% against %s\n",
+            regressions, tolerance * 100.0, baseline_path);
+    return 1;
+  }
+
+  return 0;
+}
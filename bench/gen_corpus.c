@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Generates a large synthetic FerroLang program for the benchmarks.
+// Usage: gen_corpus [options] -o <file.fl>
+
+// Shape of the generated program.
+typedef struct {
+  size_t functions;      // Functions defined in the program.
+  size_t depth;          // Length of every call chain.
+  size_t foreign;        // `@foreign` declarations.
+  size_t literal_length; // Bytes of every long string literal.
+  size_t comment_lines;  // Comment lines in front of every function.
+  const char *output_path;
+} CorpusOptions;
+
+// Helper function to write a string literal of roughly the given length.
+// Literals with a prefix are unique, the others repeat across functions.
+void write_literal(FILE *out, const char *prefix, size_t length,
+                   size_t seed) {
+  static const char *words[] = {"lorem", "ipsum", "dolor", "sit",  "amet",
+                                "ferro", "lang",  "llvm",  "\\n", "\\\""};
+  size_t word_count = sizeof(words) / sizeof(words[0]);
+
+  fputc('"', out);
+  size_t written = fprintf(out, "%s", prefix);
+  for (size_t i = 0; written < length; i++) {
+    const char *word = words[(seed + i * 7) % word_count];
+    written += fprintf(out, "%s ", word);
+  }
+  fputc('"', out);
+}
+
+// Helper function to parse a numeric option.
+size_t parse_count(const char *flag, const char *value) {
+  char *end = NULL;
+  unsigned long long count = strtoull(value, &end, 10);
+  if (!value[0] || *end != '\0') {
+    fprintf(stderr, "Invalid value for %s: %s\n", flag, value);
+    exit(1);
+  }
+  return (size_t)count;
+}
+
+int main(int argc, char **argv) {
+  CorpusOptions options = {.functions = 20000,
+                           .depth = 50,
+                           .foreign = 2000,
+                           .literal_length = 200,
+                           .comment_lines = 2,
+                           .output_path = NULL};
+
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc) {
+      fprintf(stderr, "Missing value for %s\n", argv[i]);
+      return 1;
+    }
+
+    if (strcmp(argv[i], "--functions") == 0) {
+      options.functions = parse_count(argv[i], argv[i + 1]);
+    } else if (strcmp(argv[i], "--depth") == 0) {
+      options.depth = parse_count(argv[i], argv[i + 1]);
+    } else if (strcmp(argv[i], "--foreign") == 0) {
+      options.foreign = parse_count(argv[i], argv[i + 1]);
+    } else if (strcmp(argv[i], "--literal-length") == 0) {
+      options.literal_length = parse_count(argv[i], argv[i + 1]);
+    } else if (strcmp(argv[i], "--comment-lines") == 0) {
+      options.comment_lines = parse_count(argv[i], argv[i + 1]);
+    } else if (strcmp(argv[i], "-o") == 0) {
+      options.output_path = argv[i + 1];
+    } else {
+      fprintf(stderr, "Unknown option: %s\n", argv[i]);
+      return 1;
+    }
+    i++;
+  }
+
+  if (!options.output_path || options.depth == 0 || options.foreign == 0) {
+    fprintf(stderr, "Usage: %s [--functions N] [--depth N] [--foreign N] "
+                    "[--literal-length N] [--comment-lines N] -o <file.fl>\n",
+            argv[0]);
+    return 1;
+  }
+
+  FILE *out = fopen(options.output_path, "w");
+  if (!out) {
+    fprintf(stderr, "Could not open file at: %s\n", options.output_path);
+    return 1;
+  }
+
+  fprintf(out, "# Generated by bench/gen_corpus.c, do not edit.\n");
+  fprintf(out, "@foreign(\"stdio.h\", \"printf\")\n");
+  fprintf(out, "void _cprintf(String ...args);\n\n");
+  for (size_t i = 0; i < options.foreign; i++) {
+    fprintf(out, "@foreign(\"ext.h\", \"ext_%zu\")\n", i);
+    fprintf(out, "void ext_%zu(String value, int count);\n", i);
+  }
+
+  // Every function calls the next one of its chain, a foreign function and
+  // printf with a long literal.
+  for (size_t i = 0; i < options.functions; i++) {
+    fprintf(out, "\n");
+    for (size_t j = 0; j < options.comment_lines; j++) {
+      fprintf(out, "# fn_%zu: synthetic function %zu of %zu, comment line "
+                   "%zu.\n",
+              i, i, options.functions, j);
+    }
+
+    fprintf(out, "void fn_%zu() {\n", i);
+    if ((i + 1) % options.depth != 0 && i + 1 < options.functions) {
+      fprintf(out, "  fn_%zu();\n", i + 1);
+    }
+    fprintf(out, "  ext_%zu(", i % options.foreign);
+    write_literal(out, "", options.literal_length / 4, i);
+    fprintf(out, ", %zu);\n", i % 100);
+    fprintf(out, "  _cprintf(\"%%s\\n\", ");
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "fn_%zu: ", i);
+    write_literal(out, prefix, options.literal_length, i);
+    fprintf(out, ");\n}\n");
+  }
+
+  // Main calls the head of every chain.
+  fprintf(out, "\nint main() {\n");
+  for (size_t i = 0; i < options.functions; i += options.depth) {
+    fprintf(out, "  fn_%zu();\n", i);
+  }
+  fprintf(out, "  return 0;\n}\n");
+
+  fclose(out);
+  return 0;
+}
@@ -0,0 +1,78 @@
+#include "include/arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Every allocation is aligned for the strictest fundamental type.
+#define ARENA_ALIGNMENT 16
+
+// Helper function to round a size up to the arena alignment.
+static size_t arena_align(size_t size) {
+  return (size + (ARENA_ALIGNMENT - 1)) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+// Helper function to obtain the usable bytes of a chunk.
+static char *chunk_data(ArenaChunk *chunk) {
+  return (char *)chunk + arena_align(sizeof(ArenaChunk));
+}
+
+// Helper function to request a new chunk from the system allocator.
+static ArenaChunk *arena_new_chunk(Arena *arena, size_t minimum_size) {
+  size_t capacity =
+      minimum_size > ARENA_CHUNK_SIZE ? minimum_size : ARENA_CHUNK_SIZE;
+
+  ArenaChunk *chunk = malloc(arena_align(sizeof(ArenaChunk)) + capacity);
+  if (!chunk) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(1);
+  }
+
+  chunk->capacity = capacity;
+  chunk->used = 0;
+
+  // Oversized chunks are placed behind the current one, so the remaining
+  // space of the current chunk stays available for small allocations.
+  if (arena->head && capacity > ARENA_CHUNK_SIZE) {
+    chunk->next = arena->head->next;
+    arena->head->next = chunk;
+  } else {
+    chunk->next = arena->head;
+    arena->head = chunk;
+  }
+
+  arena->chunk_count++;
+  arena->peak_bytes += capacity;
+  return chunk;
+}
+
+// Function to initialise the arena.
+void arena_init(Arena *arena) { memset(arena, 0, sizeof(*arena)); }
+
+// Function to allocate zeroed memory from the arena.
+void *arena_alloc(Arena *arena, size_t size) {
+  size = arena_align(size == 0 ? 1 : size);
+
+  arena->bytes_requested += size;
+
+  ArenaChunk *chunk = arena->head;
+  if (!chunk || chunk->capacity - chunk->used < size) {
+    chunk = arena_new_chunk(arena, size);
+  }
+
+  char *data = chunk_data(chunk) + chunk->used;
+  chunk->used += size;
+  memset(data, 0, size);
+  return data;
+}
+
+// Function to release every chunk of the arena at once.
+void arena_free(Arena *arena) {
+  ArenaChunk *chunk = arena->head;
+  while (chunk) {
+    ArenaChunk *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+
+  arena->head = NULL;
+}
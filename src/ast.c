@@ -1,20 +1,31 @@
 #include "include/ast.h"
+#include "include/intern.h"
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
-
-// Function to generate Abstract Syntax Tree (AST).
-AstNode *ast_new(AstNodeKind kind, Token token) {
-  AstNode *node = malloc(sizeof(AstNode));
-  if (!node) {
-    fprintf(stderr, "Memory allocation failed\n");
-    exit(1);
-  }
 
-  memset(node, 0, sizeof(*node));
-  node->kind = kind;
-  node->token = token;
-  return node;
+// Roughly one node per this many source bytes, used to size the arrays.
+#define AST_BYTES_PER_NODE 16
+
+// Function to initialise an empty syntax tree for a source file.
+void ast_init(Ast *ast, const char *source, size_t source_size) {
+  token_buffer_init(&ast->tokens, source, source_size);
+
+  vec_init(AstNode, &ast->nodes);
+  vec_resize(AstNode, &ast->nodes, source_size / AST_BYTES_PER_NODE + 16);
+  vec_init(uint32_t, &ast->extra);
+  vec_resize(uint32_t, &ast->extra, source_size / AST_BYTES_PER_NODE + 16);
+
+  // Reserving the root, so that index 0 is free to mean "no node".
+  ast_add_node(ast, AST_TRANSLATION_UNIT, 0, 0, 0);
+}
+
+// Function to append a node, returning its index.
+AstIndex ast_add_node(Ast *ast, AstNodeKind kind, TokenIndex main_token,
+                      uint32_t lhs, uint32_t rhs) {
+  AstNode node = {
+      .kind = kind, .main_token = main_token, .lhs = lhs, .rhs = rhs};
+  vec_push(AstNode, &ast->nodes, node);
+  return (AstIndex)(ast->nodes.length - 1);
 }
 
 // Helper function to print text with indent.
@@ -26,225 +37,262 @@ void print_with_indent(const char *data, int indent) {
   }
 }
 
+// Helper function to print the children stored in extra[start, end).
+void print_children(const Ast *ast, uint32_t start, uint32_t end,
+                    int indent) {
+  for (uint32_t i = start; i < end; i++) {
+    ast_print(ast, ast->extra.data[i], indent);
+  }
+}
+
+// Helper function to print the source text of a token.
+void print_token(const Ast *ast, TokenIndex index) {
+  Token token = ast_token(ast, index);
+  printf("%.*s", (int)token.length, token.start_ptr);
+}
+
 // Function to print AST to the console.
-void ast_print(const AstNode *node, int indent) {
+void ast_print(const Ast *ast, AstIndex index, int indent) {
+  const AstNode *node = ast_node(ast, index);
   switch (node->kind) {
   case AST_FOREIGN_DECLARATION: {
-
-    char *s = (char *)malloc(node->as.foreign_declaration.fn_name.length + 1);
-    sprintf(s, "%.*s", (int)node->as.foreign_declaration.fn_name.length,
-            node->as.foreign_declaration.fn_name.start_ptr);
     print_with_indent("AST_FOREIGN_DECLARATION(", indent);
-    print_with_indent(s, 0);
-    print_with_indent(")\n", 0);
+    print_token(ast, node->main_token + 1);
+    printf(")\n");
   } break;
-  case AST_STRING_LITERAL_EXPRESSION: {
-    size_t buffer_size = (int)node->as.string_literal.token.length +
-                         50; // Extra space for format
-    char *s = (char *)malloc(buffer_size);
-    if (!s) {
-      fprintf(stderr, "Memory allocation failed\n");
-      exit(1);
-    }
-
-    // Copy the literal value from the token
-    snprintf(s, buffer_size, "%.*s", (int)node->as.string_literal.token.length,
-             node->as.string_literal.token.start_ptr);
 
+  case AST_STRING_LITERAL_EXPRESSION: {
     // Print the literal value of the token
     print_with_indent("AST_STRING_LITERAL_EXPRESSION(", indent);
-    print_with_indent(s, 0); // Prints the actual value
-    print_with_indent(")\n", 0);
-
-    // Free the allocated string after printing
-    free(s);
+    print_token(ast, node->main_token);
+    printf(")\n");
   } break;
-    ;
-  case AST_INT_LITERAL_EXPRESSION: {
-    size_t buffer_size =
-        (int)node->as.literal.token.length + 50; // Extra space for format
-    char *s = (char *)malloc(buffer_size);
-    if (!s) {
-      fprintf(stderr, "Memory allocation failed\n");
-      exit(1);
-    }
-
-    // Copy the literal value from the token
-    snprintf(s, buffer_size, "%.*s", (int)node->as.literal.token.length,
-             node->as.literal.token.start_ptr);
 
+  case AST_INT_LITERAL_EXPRESSION: {
     // Print the literal value of the token
     print_with_indent("AST_INT_LITERAL_EXPRESSION(", indent);
-    print_with_indent(s, 0); // Prints the actual value
-    print_with_indent(")\n", 0);
-
-    // Free the allocated string after printing
-    free(s);
+    print_token(ast, node->main_token);
+    printf(")\n");
   } break;
 
   case AST_IDENTIFIER_EXPRESSION: {
-    size_t buffer_size =
-        node->as.identifier.token.length + 50; // Extra space for format string
-    char *s = (char *)malloc(buffer_size);
-    if (!s) {
-      fprintf(stderr, "Memory allocation failed\n");
-      exit(1);
-    }
-    snprintf(s, buffer_size, "%s(%.*s)\n", "AST_IDENTIFIER_EXPRESSION",
-             (int)node->as.identifier.token.length,
-             node->as.identifier.token.start_ptr);
+    print_with_indent("AST_IDENTIFIER_EXPRESSION(", indent);
+    print_token(ast, node->main_token);
+    printf(")\n");
+  } break;
 
-    print_with_indent(s, indent);
-    free(s);
+  case AST_CAST_EXPRESSION: {
+    print_with_indent("AST_CAST_EXPRESSION(", indent);
+    print_token(ast, node->main_token);
+    printf(")\n");
+    ast_print(ast, node->lhs, indent + 2);
   } break;
 
-  case AST_PARAMETER: {
-    size_t name_len = node->as.parameter.parameter_name.length;
-    size_t type_len = node->as.parameter.parameter_type.length;
-    size_t buffer_size = name_len + type_len + 18; // Extra space for format
-
-    char *s = malloc(buffer_size);
-    if (!s) {
-      fprintf(stderr, "Memory allocation failed\n");
-      exit(1);
+  case AST_BINARY_EXPRESSION: {
+    print_with_indent("AST_BINARY_EXPRESSION(", indent);
+    print_token(ast, node->main_token);
+    printf(")\n");
+    ast_print(ast, node->lhs, indent + 2);
+    ast_print(ast, node->rhs, indent + 2);
+  } break;
+
+  case AST_UNARY_EXPRESSION: {
+    print_with_indent("AST_UNARY_EXPRESSION(", indent);
+    print_token(ast, node->main_token);
+    printf(")\n");
+    ast_print(ast, node->lhs, indent + 2);
+  } break;
+
+  case AST_BOOL_LITERAL_EXPRESSION: {
+    print_with_indent("AST_BOOL_LITERAL_EXPRESSION(", indent);
+    printf("%s)\n", node->lhs ? "true" : "false");
+  } break;
+
+  case AST_CONSTANT_EXPRESSION: {
+    print_with_indent("AST_CONSTANT_EXPRESSION(", indent);
+    printf("%lld)\n", (long long)ast_constant_value(node));
+  } break;
+
+  case AST_INDEX_EXPRESSION: {
+    print_with_indent("AST_INDEX_EXPRESSION\n", indent);
+    ast_print(ast, node->lhs, indent + 2);
+    ast_print(ast, node->rhs, indent + 2);
+  } break;
+
+  case AST_SLICE_EXPRESSION: {
+    print_with_indent("AST_SLICE_EXPRESSION\n", indent);
+    ast_print(ast, node->lhs, indent + 2);
+    for (uint32_t i = node->rhs; i < node->rhs + 2; i++) {
+      if (ast->extra.data[i] == AST_NONE) {
+        print_with_indent(i == node->rhs ? "Start: 0\n" : "End: length\n",
+                          indent + 2);
+      } else {
+        ast_print(ast, ast->extra.data[i], indent + 2);
+      }
     }
+  } break;
 
-    snprintf(s, buffer_size, "-> %.*s(%.*s", (int)type_len,
-             node->as.parameter.parameter_type.start_ptr, (int)name_len,
-             node->as.parameter.parameter_name.start_ptr);
+  case AST_VECTOR_EXPRESSION: {
+    print_with_indent("AST_VECTOR_EXPRESSION(", indent);
+    print_token(ast, node->main_token);
+    printf(")\n");
+    print_children(ast, node->lhs, node->rhs, indent + 2);
+  } break;
 
-    print_with_indent(s, indent);
-    if (node->as.parameter.is_tail_parameter) {
+  case AST_PARAMETER: {
+    print_with_indent("-> ", indent);
+    print_token(ast, node->main_token);
+    printf("(");
+    print_token(ast, node->main_token + 1 + node->lhs);
+    if (node->lhs) {
       print_with_indent(", is_tail", 0);
     }
+    if (node->rhs & AST_PARAMETER_SIZED) {
+      print_with_indent(", is_sized", 0);
+    }
+    if (node->rhs & AST_PARAMETER_NOALIAS) {
+      print_with_indent(", is_noalias", 0);
+    }
     print_with_indent(")\n", 0);
-    free(s);
   } break;
 
   case AST_BLOCK_STATEMENT: {
     print_with_indent("AST_BLOCK_STATEMENT {\n", indent);
-    for (int i = 0; i < (int)node->as.block_statement.statements.length; i++) {
-      ast_print(node->as.block_statement.statements.data[i], indent + 2);
-    }
+    print_children(ast, node->lhs, node->rhs, indent + 2);
     print_with_indent("}\n", indent);
   } break;
 
   case AST_FUNCTION_DECLARATION: {
-    size_t buffer_size = node->as.function_declaration.fn_name.length +
-                         node->as.function_declaration.return_type.length + 50;
-    char *s = (char *)malloc(buffer_size);
-    if (!s) {
-      fprintf(stderr, "Memory allocation failed\n");
-      exit(1);
-    }
-
-    snprintf(s, buffer_size, "AST_FUNCTION_DECLARATION %.*s(%.*s)\n",
-             (int)node->as.function_declaration.fn_name.length,
-             node->as.function_declaration.fn_name.start_ptr,
-             (int)node->as.function_declaration.return_type.length,
-             node->as.function_declaration.return_type.start_ptr);
-
-    print_with_indent(s, indent);
-    free(s);
+    print_with_indent("AST_FUNCTION_DECLARATION ", indent);
+    print_token(ast, node->main_token + 1);
+    printf("(");
+    print_token(ast, node->main_token);
+    printf(")\n");
 
     // Print parameters
-    if (node->as.function_declaration.parameters.length > 0) {
+    uint32_t params_start = ast->extra.data[node->lhs];
+    uint32_t params_end = ast->extra.data[node->lhs + 1];
+    if (params_end > params_start) {
       print_with_indent("Parameters:\n", indent + 2);
-      for (int i = 0; i < (int)node->as.function_declaration.parameters.length;
-           i++) {
-        ast_print(node->as.function_declaration.parameters.data[i], indent + 4);
-      }
+      print_children(ast, params_start, params_end, indent + 4);
     }
 
     // Print function body
-    ast_print(node->as.function_declaration.block, indent + 2);
+    ast_print(ast, node->rhs, indent + 2);
   }; break;
 
   case AST_RETURN_STATEMENT: {
     print_with_indent("AST_RETURN_STATEMENT: \n", indent);
-    ast_print(node->as.return_statement.value, indent + 2);
+    if (node->lhs != AST_NONE) {
+      ast_print(ast, node->lhs, indent + 2);
+    }
   } break;
 
-  case AST_CALL_EXPRESSION: {
-    print_with_indent("AST_CALL_EXPRESSION\n", indent);
-
-    size_t buffer_size = node->as.call_expression.callee->token.length + 20;
-    char *s = (char *)malloc(buffer_size);
-    if (!s) {
-      fprintf(stderr, "Memory allocation failed\n");
-      exit(1);
+  case AST_LET_STATEMENT: {
+    print_with_indent("AST_LET_STATEMENT ", indent);
+    print_token(ast, node->main_token);
+    if (node->rhs) {
+      printf("(");
+      print_token(ast, node->rhs);
+      printf(")");
     }
+    printf("\n");
+    ast_print(ast, node->lhs, indent + 2);
+  } break;
 
-    snprintf(s, buffer_size, "Callee: %.*s\n",
-             (int)node->as.call_expression.callee->token.length,
-             node->as.call_expression.callee->token.start_ptr);
-
-    print_with_indent(s, indent + 2);
-    free(s);
-
-    // Print arguments if any
-    if (node->as.call_expression.arguments.length > 0) {
-      print_with_indent("Arguments:\n", indent + 2);
-      for (int i = 0; i < (int)node->as.call_expression.arguments.length; i++) {
-        ast_print(node->as.call_expression.arguments.data[i], indent + 4);
-      }
-    }
+  case AST_ASSIGN_STATEMENT: {
+    print_with_indent("AST_ASSIGN_STATEMENT\n", indent);
+    ast_print(ast, node->lhs, indent + 2);
+    ast_print(ast, node->rhs, indent + 2);
   } break;
 
-  case AST_TRANSLATION_UNIT:
-    print_with_indent("AST_TRANSLATION_UNIT\n", indent);
-    for (int i = 0; i < (int)node->as.translation_unit.declarations.length;
-         i++) {
-      ast_print(node->as.translation_unit.declarations.data[i], indent + 2);
+  case AST_IF_STATEMENT: {
+    print_with_indent("AST_IF_STATEMENT\n", indent);
+    ast_print(ast, node->lhs, indent + 2);
+    ast_print(ast, ast->extra.data[node->rhs], indent + 2);
+    if (ast->extra.data[node->rhs + 1] != AST_NONE) {
+      print_with_indent("Else:\n", indent + 2);
+      ast_print(ast, ast->extra.data[node->rhs + 1], indent + 4);
     }
-    break;
-  }
-};
+  } break;
 
-void ast_free(AstNode *node) {
-  if (!node)
-    return;
+  case AST_WHILE_STATEMENT: {
+    print_with_indent("AST_WHILE_STATEMENT\n", indent);
+    ast_print(ast, node->lhs, indent + 2);
+    ast_print(ast, node->rhs, indent + 2);
+  } break;
 
-  switch (node->kind) {
-  case AST_TRANSLATION_UNIT:
-    for (size_t i = 0; i < node->as.translation_unit.declarations.length; i++) {
-      ast_free(node->as.translation_unit.declarations.data[i]);
+  case AST_FOR_STATEMENT: {
+    print_with_indent("AST_FOR_STATEMENT\n", indent);
+    for (uint32_t i = node->lhs; i < node->lhs + 3; i++) {
+      if (ast->extra.data[i] != AST_NONE) {
+        ast_print(ast, ast->extra.data[i], indent + 2);
+      }
     }
-    vec_free(AstNode *, &node->as.translation_unit.declarations);
-    break;
+    ast_print(ast, node->rhs, indent + 2);
+  } break;
 
-  case AST_FUNCTION_DECLARATION:
-    for (size_t i = 0; i < node->as.function_declaration.parameters.length;
-         i++) {
-      ast_free(node->as.function_declaration.parameters.data[i]);
-    }
-    vec_free(AstNode *, &node->as.function_declaration.parameters);
-    ast_free(node->as.function_declaration.block);
+  case AST_BREAK_STATEMENT:
+    print_with_indent("AST_BREAK_STATEMENT\n", indent);
     break;
 
-  case AST_BLOCK_STATEMENT:
-    for (size_t i = 0; i < node->as.block_statement.statements.length; i++) {
-      ast_free(node->as.block_statement.statements.data[i]);
-    }
-    vec_free(AstNode *, &node->as.block_statement.statements);
+  case AST_CONTINUE_STATEMENT:
+    print_with_indent("AST_CONTINUE_STATEMENT\n", indent);
     break;
 
   case AST_CALL_EXPRESSION: {
-    ast_free(node->as.call_expression.callee);
-    for (size_t i = 0; i < node->as.call_expression.arguments.length; i++) {
-      ast_free(node->as.call_expression.arguments.data[i]);
+    print_with_indent("AST_CALL_EXPRESSION\n", indent);
+    print_with_indent("Callee: ", indent + 2);
+    print_token(ast, node->main_token);
+    printf("\n");
+
+    // Print arguments if any
+    if (node->rhs > node->lhs) {
+      print_with_indent("Arguments:\n", indent + 2);
+      print_children(ast, node->lhs, node->rhs, indent + 4);
     }
-    vec_free(AstNode *, &node->as.call_expression.arguments);
   } break;
 
-  case AST_RETURN_STATEMENT:
-    ast_free(node->as.return_statement.value);
-    break;
-
-  // Other cases don't have child nodes to free
-  default:
+  case AST_TRANSLATION_UNIT:
+    print_with_indent("AST_TRANSLATION_UNIT\n", indent);
+    print_children(ast, node->lhs, node->rhs, indent + 2);
     break;
   }
+}
 
-  free(node);
-}
\ No newline at end of file
+// Function to add the memory held by a syntax tree to a running total.
+void ast_memory_add(AstMemory *memory, const Ast *ast) {
+  memory->token_count += ast->tokens.count;
+  memory->token_bytes += token_buffer_bytes(&ast->tokens, false);
+  memory->token_reserved_bytes += token_buffer_bytes(&ast->tokens, true);
+  memory->node_count += ast->nodes.length;
+  memory->node_bytes += ast->nodes.length * sizeof(AstNode);
+  memory->node_reserved_bytes += ast->nodes.capacity * sizeof(AstNode);
+  memory->extra_count += ast->extra.length;
+  memory->extra_bytes += ast->extra.length * sizeof(uint32_t);
+  memory->extra_reserved_bytes += ast->extra.capacity * sizeof(uint32_t);
+}
+
+// Function to print the memory held by the syntax trees.
+void ast_memory_print(const AstMemory *memory, FILE *stream) {
+  fprintf(stream, "ast: %zu tokens, %zu bytes used, %zu bytes reserved\n",
+          memory->token_count, memory->token_bytes,
+          memory->token_reserved_bytes);
+  fprintf(stream, "ast: %zu nodes, %zu bytes used, %zu bytes reserved\n",
+          memory->node_count, memory->node_bytes,
+          memory->node_reserved_bytes);
+  fprintf(stream, "ast: %zu extra, %zu bytes used, %zu bytes reserved\n",
+          memory->extra_count, memory->extra_bytes,
+          memory->extra_reserved_bytes);
+  fprintf(stream, "ast: %zu bytes used, %zu bytes reserved in total\n",
+          memory->token_bytes + memory->node_bytes + memory->extra_bytes,
+          memory->token_reserved_bytes + memory->node_reserved_bytes +
+              memory->extra_reserved_bytes);
+}
+
+// Function to release the syntax tree, including its tokens.
+void ast_free(Ast *ast) {
+  token_buffer_free(&ast->tokens);
+  vec_free(AstNode, &ast->nodes);
+  vec_free(uint32_t, &ast->extra);
+}
@@ -0,0 +1,334 @@
+#include "include/cache.h"
+#include "include/ast.h"
+#include "include/helpers.h"
+#include "include/intern.h"
+#include "include/source.h"
+#include "llvm-c/BitReader.h"
+#include "llvm-c/BitWriter.h"
+#include "llvm-c/Core.h"
+#include "llvm-c/TargetMachine.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Bumped whenever the layout of the cache directory changes.
+#define CACHE_FORMAT_VERSION 1
+
+// Helper function to fold a value into a running hash.
+static uint64_t hash_combine(uint64_t hash, uint64_t value) {
+  uint64_t pair[2] = {hash, value};
+  return hash_bytes((const char *)pair, sizeof(pair));
+}
+
+// Helper function to hash the text of a token.
+static uint64_t hash_token(const Ast *ast, TokenIndex index) {
+  Token token = ast_token(ast, index);
+  return hash_bytes(token.start_ptr, token.length);
+}
+
+// Function to open the cache directory, creating it when needed.
+void module_cache_init(ModuleCache *cache, const char *directory,
+                       unsigned optimization_level) {
+  if (mkdir(directory, 0777) != 0 && errno != EEXIST) {
+    fprintf(stderr, "Could not create the cache directory: %s\n", directory);
+    exit(1);
+  }
+
+  cache->directory = directory;
+  cache->hits = 0;
+  cache->misses = 0;
+
+  // A rebuilt compiler may generate different code for the same source, so
+  // its build time is part of every key.
+  const char *build = __DATE__ " " __TIME__;
+  char *triple = LLVMGetDefaultTargetTriple();
+  uint64_t hash = hash_bytes(build, strlen(build));
+  hash = hash_combine(hash, hash_bytes(triple, strlen(triple)));
+  hash = hash_combine(hash, CACHE_FORMAT_VERSION);
+  cache->flags_hash = hash_combine(hash, optimization_level);
+  LLVMDisposeMessage(triple);
+}
+
+// Function to hash the path and contents of a source file.
+uint64_t module_cache_source_hash(const SourceFile *source) {
+  // The path names the module, so moving a file changes its output.
+  uint64_t hash = hash_bytes(source->path, strlen(source->path));
+  return hash_combine(hash, hash_bytes(source->contents, source->size));
+}
+
+// Helper function to hash the signature of a declaration. Parameter names
+// do not change how a call is lowered, so only the types are hashed.
+static uint64_t hash_signature(const Ast *ast, const AstNode *node) {
+  uint32_t params_start, params_end;
+  ast_declaration_parameters(ast, node, &params_start, &params_end);
+
+  // Return type, and for foreign functions the C symbol.
+  uint64_t hash = hash_combine(node->kind, hash_token(ast, node->main_token));
+  if (node->kind == AST_FOREIGN_DECLARATION) {
+    hash = hash_combine(hash, hash_token(ast, node->main_token - 2));
+  }
+
+  // Annotations change the attributes callers see.
+  TokenIndex annotations_start, annotations_end;
+  ast_declaration_annotations(ast, node, &annotations_start, &annotations_end);
+  for (TokenIndex i = annotations_start; i < annotations_end; i++) {
+    hash = hash_combine(hash, ast->tokens.kinds[i]);
+  }
+
+  hash = hash_combine(hash, params_end - params_start);
+  for (uint32_t i = params_start; i < params_end; i++) {
+    const AstNode *param = ast_node(ast, ast->extra.data[i]);
+    hash = hash_combine(hash, hash_token(ast, param->main_token));
+    hash = hash_combine(hash, param->lhs);
+    hash = hash_combine(hash, param->rhs);
+  }
+
+  return hash;
+}
+
+// Function to collect the interface of a parsed file.
+void module_cache_interface_init(CacheInterface *interface, const Ast *ast) {
+  vec_init(CacheSignature, &interface->declarations);
+  vec_init(InternId, &interface->calls);
+
+  const AstNode *unit = ast_node(ast, 0);
+  for (uint32_t i = unit->lhs; i < unit->rhs; i++) {
+    const AstNode *node = ast_node(ast, ast->extra.data[i]);
+    CacheSignature signature = {
+        .name = ast->tokens.intern_ids[node->main_token + 1],
+        .hash = hash_signature(ast, node)};
+    vec_push(CacheSignature, &interface->declarations, signature);
+  }
+
+  // Every call is a node of its own, so no walk of the tree is needed.
+  // Identifiers start at one, INTERN_NONE is never a callee.
+  bool *seen = calloc(intern_count() + 1, sizeof(bool));
+  if (!seen) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(1);
+  }
+  for (size_t i = 0; i < ast->nodes.length; i++) {
+    const AstNode *node = &ast->nodes.data[i];
+    if (node->kind != AST_CALL_EXPRESSION) {
+      continue;
+    }
+
+    InternId callee = ast->tokens.intern_ids[node->main_token];
+    if (!seen[callee]) {
+      seen[callee] = true;
+      vec_push(InternId, &interface->calls, callee);
+    }
+  }
+  free(seen);
+}
+
+// Function to release an interface.
+void module_cache_interface_free(CacheInterface *interface) {
+  vec_free(CacheSignature, &interface->declarations);
+  vec_free(InternId, &interface->calls);
+}
+
+// Function to derive the module key of every file of the program.
+void module_cache_keys(const ModuleCache *cache,
+                       const uint64_t *source_hashes,
+                       const CacheInterface *interfaces, size_t unit_count,
+                       uint64_t *keys) {
+  // Signature hashes indexed by the function's name, zero when no file
+  // declares it.
+  uint64_t *signatures = calloc(intern_count() + 1, sizeof(uint64_t));
+  if (!signatures) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(1);
+  }
+  for (size_t i = 0; i < unit_count; i++) {
+    for (size_t j = 0; j < interfaces[i].declarations.length; j++) {
+      const CacheSignature *signature = &interfaces[i].declarations.data[j];
+      signatures[signature->name] = signature->hash;
+    }
+  }
+
+  // Adding or changing a function therefore only invalidates its callers.
+  for (size_t i = 0; i < unit_count; i++) {
+    uint64_t hash = hash_combine(cache->flags_hash, source_hashes[i]);
+    for (size_t j = 0; j < interfaces[i].calls.length; j++) {
+      InternId callee = interfaces[i].calls.data[j];
+      hash = hash_combine(hash, intern_get(callee)->hash);
+      hash = hash_combine(hash, signatures[callee]);
+    }
+    keys[i] = hash;
+  }
+
+  free(signatures);
+}
+
+// Helper function to build the path of a cache entry.
+static char *cache_entry_path(const ModuleCache *cache, uint64_t key,
+                              const char *extension) {
+  size_t size = strlen(cache->directory) + 64;
+  char *path = malloc(size);
+  if (!path) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(1);
+  }
+
+  snprintf(path, size, "%s/%016llx.%s", cache->directory,
+           (unsigned long long)key, extension);
+  return path;
+}
+
+// Helper function to move a finished entry into place. Entries are written
+// under a temporary name first, so other compilers sharing the directory
+// never read a partial file.
+static void publish_cache_entry(const char *temporary_path,
+                                const char *path) {
+  if (rename(temporary_path, path) != 0) {
+    fprintf(stderr, "Could not write the cache entry: %s\n", path);
+    remove(temporary_path);
+    exit(1);
+  }
+}
+
+// Helper function to build the temporary path of an entry being written.
+static char *temporary_entry_path(const char *path) {
+  size_t size = strlen(path) + 32;
+  char *temporary_path = malloc(size);
+  if (!temporary_path) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(1);
+  }
+
+  snprintf(temporary_path, size, "%s.%ld.tmp", path, (long)getpid());
+  return temporary_path;
+}
+
+// Function to look up the interface recorded for a source file.
+// Every line is either "declare <name> <signature hash>" or "call <name>".
+bool module_cache_load_interface(const ModuleCache *cache,
+                                 uint64_t source_hash,
+                                 CacheInterface *interface) {
+  char *path = cache_entry_path(cache, source_hash, "interface");
+  FILE *file = fopen(path, "r");
+  free(path);
+  if (!file) {
+    return false;
+  }
+
+  vec_init(CacheSignature, &interface->declarations);
+  vec_init(InternId, &interface->calls);
+
+  char *line = NULL;
+  size_t line_capacity = 0;
+  ssize_t line_length;
+  bool valid = true;
+  while (valid && (line_length = getline(&line, &line_capacity, file)) > 0) {
+    if (line[line_length - 1] == '\n') {
+      line[--line_length] = '\0';
+    }
+
+    if (strncmp(line, "declare ", 8) == 0) {
+      char *name = line + 8;
+      char *hash = strchr(name, ' ');
+      valid = hash != NULL;
+      if (valid) {
+        CacheSignature signature = {
+            .name = intern(name, (size_t)(hash - name)),
+            .hash = strtoull(hash + 1, NULL, 16)};
+        vec_push(CacheSignature, &interface->declarations, signature);
+      }
+    } else if (strncmp(line, "call ", 5) == 0) {
+      InternId callee = intern(line + 5, (size_t)line_length - 5);
+      vec_push(InternId, &interface->calls, callee);
+    } else {
+      valid = false;
+    }
+  }
+  free(line);
+  fclose(file);
+
+  // A damaged entry is treated like a missing one.
+  if (!valid) {
+    module_cache_interface_free(interface);
+  }
+  return valid;
+}
+
+// Function to record the interface of a source file.
+void module_cache_store_interface(const ModuleCache *cache,
+                                  uint64_t source_hash,
+                                  const CacheInterface *interface) {
+  char *path = cache_entry_path(cache, source_hash, "interface");
+  char *temporary_path = temporary_entry_path(path);
+
+  FILE *file = fopen(temporary_path, "w");
+  if (!file) {
+    fprintf(stderr, "Could not write the cache entry: %s\n", path);
+    exit(1);
+  }
+  for (size_t i = 0; i < interface->declarations.length; i++) {
+    const CacheSignature *signature = &interface->declarations.data[i];
+    fprintf(file, "declare %s %016llx\n", intern_get(signature->name)->data,
+            (unsigned long long)signature->hash);
+  }
+  for (size_t i = 0; i < interface->calls.length; i++) {
+    fprintf(file, "call %s\n", intern_get(interface->calls.data[i])->data);
+  }
+  fclose(file);
+
+  publish_cache_entry(temporary_path, path);
+  free(temporary_path);
+  free(path);
+}
+
+// Function to read a cached module into the context.
+LLVMModuleRef module_cache_load(const ModuleCache *cache, uint64_t key,
+                                LLVMContextRef llvm_context) {
+  char *path = cache_entry_path(cache, key, "bc");
+  LLVMMemoryBufferRef buffer = NULL;
+  char *err = NULL;
+  if (LLVMCreateMemoryBufferWithContentsOfFile(path, &buffer, &err)) {
+    LLVMDisposeMessage(err);
+    free(path);
+    return NULL;
+  }
+
+  // A damaged entry counts as a miss and is overwritten afterwards. This
+  // variant reports errors through the message instead of the context,
+  // which would exit.
+  LLVMModuleRef llvm_module = NULL;
+  if (LLVMParseBitcodeInContext(llvm_context, buffer, &llvm_module, &err)) {
+    fprintf(stderr, "Warning: Ignoring the damaged cache entry %s: %s\n",
+            path, err);
+    LLVMDisposeMessage(err);
+    llvm_module = NULL;
+  }
+
+  LLVMDisposeMemoryBuffer(buffer);
+  free(path);
+  return llvm_module;
+}
+
+// Function to write a module to the cache.
+void module_cache_store(const ModuleCache *cache, uint64_t key,
+                        LLVMModuleRef llvm_module) {
+  char *path = cache_entry_path(cache, key, "bc");
+  char *temporary_path = temporary_entry_path(path);
+
+  if (LLVMWriteBitcodeToFile(llvm_module, temporary_path) != 0) {
+    fprintf(stderr, "Could not write the cache entry: %s\n", path);
+    exit(1);
+  }
+
+  publish_cache_entry(temporary_path, path);
+  free(temporary_path);
+  free(path);
+}
+
+// Function to print the hit and miss counts of the cache.
+void module_cache_print_stats(const ModuleCache *cache, FILE *stream) {
+  fprintf(stream, "cache: %zu of %zu files served from %s, %zu lowered\n",
+          cache->hits, cache->hits + cache->misses, cache->directory,
+          cache->misses);
+}
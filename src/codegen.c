@@ -1,237 +1,1997 @@
 #include "include/ast.h"
+#include "include/codegen.h"
+#include "include/emit.h"
 #include "include/helpers.h"
+#include "include/intern.h"
 #include "include/lexer.h"
+#include "include/optimizer.h"
 #include "llvm-c/Analysis.h"
+#include "llvm-c/BitReader.h"
+#include "llvm-c/BitWriter.h"
 #include "llvm-c/Core.h"
+#include "llvm-c/Linker.h"
 #include "llvm-c/Types.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-// Symbol table for function lookups
+// Symbol table entry, keyed on an interned string.
 typedef struct {
-  char *name;
-  LLVMValueRef function;
-} FunctionEntry;
+  InternId name;
+  LLVMValueRef value;
+  TokenKind type; // Type keyword of a local variable, whose value is its
+                  // stack slot.
+} SymbolEntry;
 
+// Symbol table mapping interned strings to LLVM values
+// (open addressing, linear probing).
 typedef struct {
-  FunctionEntry *functions;
+  SymbolEntry *entries;
   size_t count;
-  size_t capacity;
+  size_t capacity; // Always zero or a power of two.
 } SymbolTable;
 
-static SymbolTable symbol_table = {0};
+// Location of a declaration in the syntax trees.
+typedef struct {
+  InternId name;
+  uint32_t unit; // Index of the tree holding the declaration.
+  AstIndex node;
+} DeclarationEntry;
+
+// Declaration table mapping function names to their declarations
+// (open addressing, linear probing).
+typedef struct {
+  DeclarationEntry *entries;
+  size_t count;
+  size_t capacity; // Always zero or a power of two.
+} DeclarationTable;
+
+// Codegen Defination
+// State shared by all declarations while lowering a single module.
+typedef struct {
+  LLVMContextRef llvm_context;
+  LLVMModuleRef llvm_module;
+  LLVMBuilderRef builder;
+  SymbolTable symbol_table;    // Functions, keyed on their FerroLang name.
+  SymbolTable string_literals; // `String` constants, keyed on their value.
+  SymbolTable locals;          // Variables of the function being lowered.
+  TokenKind return_type;       // Of the function being lowered.
+
+  // Names of the variables declared by the enclosing blocks, innermost
+  // last, so they go out of scope with their block.
+  Vector(InternId) scope_names;
+
+  // Targets of `break` and `continue` in the innermost loop, NULL outside
+  // of loops.
+  LLVMBasicBlockRef break_block;
+  LLVMBasicBlockRef continue_block;
+  CodegenStats *stats;
+  const Ast *asts; // Trees of every file.
+  const Ast *ast;  // Tree of the file being lowered.
+
+  // Every declaration of the program, used to type calls. Functions
+  // missing from the symbol table are declared the first time they are
+  // called, as modules lowering part of the program only declare their
+  // own functions up front.
+  const DeclarationTable *declarations;
+} Codegen;
+
+// Value Defination
+// A lowered expression together with the keyword of its FerroLang type.
+typedef struct {
+  LLVMValueRef value;
+  TokenKind type;
+} TypedValue;
+
+// Helper function to scramble an interned name into a table index.
+static inline size_t hash_intern_id(InternId id) {
+  return (size_t)(id * 0x9e3779b97f4a7c15ULL >> 32);
+}
+
+// Helper function to locate the slot for a name in the symbol table.
+SymbolEntry *symbol_table_slot(const SymbolTable *symbol_table,
+                               InternId name) {
+  size_t mask = symbol_table->capacity - 1;
+  for (size_t i = hash_intern_id(name) & mask;; i = (i + 1) & mask) {
+    SymbolEntry *entry = &symbol_table->entries[i];
+    if (entry->name == name || entry->name == INTERN_NONE) {
+      return entry;
+    }
+  }
+}
+
+// Helper function to grow the symbol table, keeping it at most half full.
+void symbol_table_grow(SymbolTable *symbol_table) {
+  SymbolTable grown = {0};
+  grown.capacity =
+      symbol_table->capacity == 0 ? 64 : symbol_table->capacity * 2;
+  grown.entries = calloc(grown.capacity, sizeof(SymbolEntry));
+  if (!grown.entries) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(1);
+  }
+
+  for (size_t i = 0; i < symbol_table->capacity; i++) {
+    SymbolEntry *entry = &symbol_table->entries[i];
+    if (entry->name != INTERN_NONE) {
+      *symbol_table_slot(&grown, entry->name) = *entry;
+      grown.count++;
+    }
+  }
+
+  free(symbol_table->entries);
+  *symbol_table = grown;
+}
+
+// Helper function to insert a value, returning false if the name is taken.
+bool symbol_table_insert(SymbolTable *symbol_table, InternId name,
+                         LLVMValueRef value) {
+  if ((symbol_table->count + 1) * 2 > symbol_table->capacity) {
+    symbol_table_grow(symbol_table);
+  }
+
+  SymbolEntry *entry = symbol_table_slot(symbol_table, name);
+  if (entry->name != INTERN_NONE) {
+    return false;
+  }
+
+  entry->name = name;
+  entry->value = value;
+  symbol_table->count++;
+  return true;
+}
+
+// Helper function to look up a value, returning NULL if it is missing.
+LLVMValueRef symbol_table_lookup(const SymbolTable *symbol_table,
+                                 InternId name) {
+  if (symbol_table->capacity == 0) {
+    return NULL;
+  }
+
+  return symbol_table_slot(symbol_table, name)->value;
+}
+
+// Helper function to release the symbol table.
+void free_symbol_table(SymbolTable *symbol_table) {
+  free(symbol_table->entries);
+  symbol_table->entries = NULL;
+  symbol_table->count = 0;
+  symbol_table->capacity = 0;
+}
+
+// Helper function to add function to symbol table
+void add_function_to_symbol_table(SymbolTable *symbol_table, Token name,
+                                  LLVMValueRef function) {
+  if (!symbol_table_insert(symbol_table, name.intern_id, function)) {
+    fprintf(stderr, "Error: Function '%.*s' is already defined (line %zu)\n",
+            (int)name.length, name.start_ptr, name.line);
+    exit(1);
+  }
+}
+
+// Helper function to find function in symbol table
+LLVMValueRef find_function_in_symbol_table(const SymbolTable *symbol_table,
+                                           Token name) {
+  return symbol_table_lookup(symbol_table, name.intern_id);
+}
+
+// Helper function to add a local variable to the innermost scope.
+// Variables out of scope keep their entry with a NULL value, so the entry
+// is reused when the name is declared again.
+void add_local(Codegen *codegen, Token name, LLVMValueRef value,
+               TokenKind type) {
+  if (!symbol_table_insert(&codegen->locals, name.intern_id, value)) {
+    SymbolEntry *entry = symbol_table_slot(&codegen->locals, name.intern_id);
+    if (entry->value) {
+      fprintf(stderr, "Error: '%.*s' is already defined (line %zu)\n",
+              (int)name.length, name.start_ptr, name.line);
+      exit(1);
+    }
+    entry->value = value;
+  }
+
+  symbol_table_slot(&codegen->locals, name.intern_id)->type = type;
+  vec_push(InternId, &codegen->scope_names, name.intern_id);
+}
+
+// Helper function to end the scopes entered since scope_top, taking their
+// variables out of reach.
+void end_scope(Codegen *codegen, size_t scope_top) {
+  for (size_t i = scope_top; i < codegen->scope_names.length; i++) {
+    symbol_table_slot(&codegen->locals, codegen->scope_names.data[i])->value =
+        NULL;
+  }
+  codegen->scope_names.length = scope_top;
+}
+
+// Helper function to find a local variable, NULL if it is missing.
+const SymbolEntry *find_local(const Codegen *codegen, Token name) {
+  if (codegen->locals.capacity == 0) {
+    return NULL;
+  }
+
+  const SymbolEntry *entry =
+      symbol_table_slot(&codegen->locals, name.intern_id);
+  return entry->value ? entry : NULL;
+}
+
+// Helper function to locate the slot for a name in the declaration table.
+DeclarationEntry *declaration_table_slot(const DeclarationTable *table,
+                                         InternId name) {
+  size_t mask = table->capacity - 1;
+  for (size_t i = hash_intern_id(name) & mask;; i = (i + 1) & mask) {
+    DeclarationEntry *entry = &table->entries[i];
+    if (entry->name == name || entry->name == INTERN_NONE) {
+      return entry;
+    }
+  }
+}
+
+// Helper function to build the declaration table of every tree, reporting
+// functions which are defined twice.
+void build_declaration_table(DeclarationTable *table, const Ast *asts,
+                             size_t unit_count) {
+  size_t declaration_count = 0;
+  for (size_t i = 0; i < unit_count; i++) {
+    const AstNode *unit = ast_node(&asts[i], 0);
+    declaration_count += unit->rhs - unit->lhs;
+  }
+
+  // Sized once up front, keeping the table at most half full.
+  table->capacity = 64;
+  while (table->capacity < declaration_count * 2) {
+    table->capacity *= 2;
+  }
+  table->entries = calloc(table->capacity, sizeof(DeclarationEntry));
+  if (!table->entries) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(1);
+  }
+
+  for (size_t i = 0; i < unit_count; i++) {
+    const Ast *ast = &asts[i];
+    const AstNode *unit = ast_node(ast, 0);
+    for (uint32_t j = unit->lhs; j < unit->rhs; j++) {
+      AstIndex index = ast->extra.data[j];
+      const AstNode *node = ast_node(ast, index);
+      if (node->kind != AST_FUNCTION_DECLARATION &&
+          node->kind != AST_FOREIGN_DECLARATION) {
+        fprintf(stderr, "Error: Unsupported AST declaration kind: %d\n",
+                node->kind);
+        exit(1);
+      }
+
+      // Both kinds of declaration have the name right after the return type.
+      Token name = ast_token(ast, node->main_token + 1);
+      DeclarationEntry *entry = declaration_table_slot(table, name.intern_id);
+      if (entry->name != INTERN_NONE) {
+        fprintf(stderr,
+                "Error: Function '%.*s' is already defined (line %zu)\n",
+                (int)name.length, name.start_ptr, name.line);
+        exit(1);
+      }
+
+      entry->name = name.intern_id;
+      entry->unit = (uint32_t)i;
+      entry->node = index;
+      table->count++;
+    }
+  }
+}
+
+// Helper function to release the declaration table.
+void free_declaration_table(DeclarationTable *table) {
+  free(table->entries);
+  table->entries = NULL;
+  table->count = 0;
+  table->capacity = 0;
+}
+
+// Helper function to obtain the width in bits of an integer type.
+unsigned integer_type_width(TokenKind type) {
+  switch (type) {
+  case TOKEN_BOOL:
+    return 1;
+  case TOKEN_I8:
+  case TOKEN_U8:
+    return 8;
+  case TOKEN_I16:
+  case TOKEN_U16:
+    return 16;
+  case TOKEN_INT:
+  case TOKEN_I32:
+  case TOKEN_U32:
+    return 32;
+  case TOKEN_I64:
+  case TOKEN_U64:
+    return 64;
+  default:
+    return 0;
+  }
+}
+
+// Helper function to check whether an integer type is signed.
+bool is_signed_integer_type(TokenKind type) {
+  return type == TOKEN_INT || type == TOKEN_I8 || type == TOKEN_I16 ||
+         type == TOKEN_I32 || type == TOKEN_I64;
+}
+
+// Helper function to obtain the type of the lanes of a vector type, or the
+// type itself for any other type. Vector operators work lane by lane, so
+// they are checked against this type.
+TokenKind scalar_type(TokenKind type) {
+  return is_vector_type(type) ? vector_element_type(type) : type;
+}
+
+// Helper function to obtain the name of a type as written in FerroLang.
+const char *type_name(TokenKind type) {
+  switch (type) {
+  case TOKEN_VOID:
+    return "void";
+  case TOKEN_STRING:
+    return "String";
+  case TOKEN_BOOL:
+    return "bool";
+  case TOKEN_INT:
+    return "int";
+  case TOKEN_I8:
+    return "i8";
+  case TOKEN_I16:
+    return "i16";
+  case TOKEN_I32:
+    return "i32";
+  case TOKEN_I64:
+    return "i64";
+  case TOKEN_U8:
+    return "u8";
+  case TOKEN_U16:
+    return "u16";
+  case TOKEN_U32:
+    return "u32";
+  case TOKEN_U64:
+    return "u64";
+  default:
+    if (is_vector_type(type)) {
+      return vector_type_name(type);
+    }
+    return token_kind_to_string(type);
+  }
+}
+
+// Helper function to convert primitive type to LLVM type.
+LLVMTypeRef
+get_llvm_equivalent_for_primitive_type(Token primitive_type_token,
+                                       LLVMContextRef llvm_context) {
+  if (is_integer_type(primitive_type_token.kind)) {
+    return LLVMIntTypeInContext(llvm_context,
+                                integer_type_width(primitive_type_token.kind));
+  }
+  if (is_vector_type(primitive_type_token.kind)) {
+    TokenKind element_type = vector_element_type(primitive_type_token.kind);
+    return LLVMVectorType(
+        LLVMIntTypeInContext(llvm_context, integer_type_width(element_type)),
+        vector_lane_count(primitive_type_token.kind));
+  }
+
+  switch (primitive_type_token.kind) {
+  case TOKEN_VOID:
+    return LLVMVoidTypeInContext(llvm_context);
+
+  case TOKEN_BOOL:
+    return LLVMInt1TypeInContext(llvm_context);
+
+  case TOKEN_STRING: {
+    // The characters and their count, which slices share without copying.
+    LLVMTypeRef i8_ptr =
+        LLVMPointerType(LLVMInt8TypeInContext(llvm_context), 0);
+    LLVMTypeRef len_type = LLVMInt64TypeInContext(llvm_context);
+    LLVMTypeRef members[] = {i8_ptr, len_type};
+    return LLVMStructTypeInContext(llvm_context, members, 2, false);
+  } break;
+
+  default:
+    fprintf(stderr, "Error: %s is not a primitive type.",
+            token_kind_to_string(primitive_type_token.kind));
+    exit(1);
+  }
+}
+
+// Helper function to obtain the LLVM type of a type keyword.
+LLVMTypeRef llvm_type_of(Codegen *codegen, TokenKind type) {
+  Token type_token = {.kind = type};
+  return get_llvm_equivalent_for_primitive_type(type_token,
+                                                codegen->llvm_context);
+}
+
+// Helper function to obtain the `String` constant for a literal value.
+// Every occurrence of the same value shares one private global.
+LLVMValueRef get_string_literal(Codegen *codegen, InternId value_id) {
+  codegen->stats->string_literals++;
+
+  LLVMValueRef cached =
+      symbol_table_lookup(&codegen->string_literals, value_id);
+  if (cached) {
+    return cached;
+  }
+
+  // Create a global constant string
+  const InternString *value = intern_get(value_id);
+  LLVMValueRef initializer = LLVMConstStringInContext(
+      codegen->llvm_context, value->data, value->length, false);
+  LLVMTypeRef array_type = LLVMTypeOf(initializer);
+
+  LLVMValueRef global = LLVMAddGlobal(codegen->llvm_module, array_type, "str");
+  LLVMSetInitializer(global, initializer);
+  LLVMSetGlobalConstant(global, true);
+  LLVMSetLinkage(global, LLVMPrivateLinkage);
+  LLVMSetAlignment(global, 1);
+
+  // Without a meaningful address the linker may merge equal strings across
+  // object files.
+  LLVMSetUnnamedAddress(global, LLVMGlobalUnnamedAddr);
+
+  // The terminator stored after the characters is not counted.
+  LLVMTypeRef i64 = LLVMInt64TypeInContext(codegen->llvm_context);
+  LLVMValueRef zero =
+      LLVMConstInt(LLVMInt32TypeInContext(codegen->llvm_context), 0, false);
+  LLVMValueRef indices[] = {zero, zero};
+  LLVMValueRef members[] = {
+      LLVMConstInBoundsGEP2(array_type, global, indices, 2),
+      LLVMConstInt(i64, value->length, false)};
+  LLVMValueRef string =
+      LLVMConstStructInContext(codegen->llvm_context, members, 2, false);
+
+  symbol_table_insert(&codegen->string_literals, value_id, string);
+  codegen->stats->unique_string_literals++;
+  return string;
+}
+
+void declare_function(Codegen *codegen, AstIndex index);
+
+// Helper function to find the function a call refers to, declaring it first
+// if the module lowers only part of the program.
+LLVMValueRef resolve_function(Codegen *codegen, Token name) {
+  LLVMValueRef function =
+      find_function_in_symbol_table(&codegen->symbol_table, name);
+  if (function || !codegen->declarations) {
+    return function;
+  }
+
+  const DeclarationEntry *entry =
+      declaration_table_slot(codegen->declarations, name.intern_id);
+  if (entry->name == INTERN_NONE) {
+    return NULL;
+  }
+
+  const Ast *current_ast = codegen->ast;
+  codegen->ast = &codegen->asts[entry->unit];
+  declare_function(codegen, entry->node);
+  codegen->ast = current_ast;
+
+  return find_function_in_symbol_table(&codegen->symbol_table, name);
+}
+
+// Helper function to check whether an integer constant, given by its sign
+// and magnitude, fits a type.
+bool integer_constant_fits(bool negative, unsigned long long magnitude,
+                           TokenKind type) {
+  unsigned width = integer_type_width(type);
+  if (!is_signed_integer_type(type)) {
+    return !negative && (width >= 64 || magnitude < (1ULL << width));
+  }
+
+  // The most negative value has no positive counterpart.
+  unsigned long long limit = 1ULL << (width - 1);
+  return negative ? magnitude <= limit : magnitude < limit;
+}
+
+// Helper function to check whether every value of an integer type can be
+// represented in another one, so it may be converted implicitly.
+bool is_widening_conversion(TokenKind from, TokenKind to) {
+  unsigned from_width = integer_type_width(from);
+  unsigned to_width = integer_type_width(to);
+  bool from_signed = is_signed_integer_type(from);
+  bool to_signed = is_signed_integer_type(to);
+
+  if (from_signed == to_signed) {
+    return to_width >= from_width;
+  }
+
+  // Unsigned values fit a wider signed type, negative values never fit an
+  // unsigned one.
+  return !from_signed && to_width > from_width;
+}
+
+// Helper function to change the width of an integer, or of every lane of a
+// vector, extending by the signedness of its own type.
+LLVMValueRef resize_integer(Codegen *codegen, TypedValue value,
+                            TokenKind type) {
+  unsigned from_width = integer_type_width(scalar_type(value.type));
+  unsigned to_width = integer_type_width(scalar_type(type));
+  LLVMTypeRef llvm_type = llvm_type_of(codegen, type);
+
+  if (to_width < from_width) {
+    return LLVMBuildTrunc(codegen->builder, value.value, llvm_type, "trunc");
+  }
+  if (to_width > from_width) {
+    return is_signed_integer_type(scalar_type(value.type))
+               ? LLVMBuildSExt(codegen->builder, value.value, llvm_type,
+                               "sext")
+               : LLVMBuildZExt(codegen->builder, value.value, llvm_type,
+                               "zext");
+  }
+  return value.value;
+}
+
+// Helper function to convert a value to the type a parameter, return
+// value or variable expects.
+LLVMValueRef convert_to_type(Codegen *codegen, TypedValue value,
+                             TokenKind type, size_t line) {
+  if (is_integer_type(value.type) && is_integer_type(type) &&
+      is_widening_conversion(value.type, type)) {
+    return resize_integer(codegen, value, type);
+  }
+  if (value.type == type) {
+    return value.value;
+  }
+
+  if (is_integer_type(value.type) && is_integer_type(type)) {
+    fprintf(stderr,
+            "Error: Converting %s to %s may change the value, write "
+            "%s(...) to convert it (line %zu)\n",
+            type_name(value.type), type_name(type), type_name(type), line);
+  } else {
+    fprintf(stderr,
+            "Error: Expected a value of type %s but got %s (line %zu)\n",
+            type_name(type), type_name(value.type), line);
+  }
+  exit(1);
+}
+
+// Helper function to create an LLVM attribute which takes no value.
+LLVMAttributeRef create_enum_attribute(Codegen *codegen, const char *name) {
+  return LLVMCreateEnumAttribute(
+      codegen->llvm_context,
+      LLVMGetEnumAttributeKindForName(name, strlen(name)), 0);
+}
+
+// Helper function to mark a narrow integer of a foreign function as sign
+// or zero extended, which the C calling convention expects the caller to
+// do. The index is LLVMAttributeReturnIndex or the parameter's index + 1.
+void add_extension_attribute(Codegen *codegen, LLVMValueRef value,
+                             LLVMAttributeIndex index, TokenKind type,
+                             bool is_call) {
+  if ((!is_integer_type(type) && type != TOKEN_BOOL) ||
+      integer_type_width(type) >= 32) {
+    return;
+  }
+
+  LLVMAttributeRef attribute = create_enum_attribute(
+      codegen, is_signed_integer_type(type) ? "signext" : "zeroext");
+  if (is_call) {
+    LLVMAddCallSiteAttribute(value, index, attribute);
+  } else {
+    LLVMAddAttributeAtIndex(value, index, attribute);
+  }
+}
+
+TypedValue convert_expression(Codegen *codegen, AstIndex index,
+                              TokenKind expected_type);
+
+// Helper function to check whether an expression is an integer literal or
+// a folded integer expression, which take the type of their context.
+bool is_untyped_constant(const Ast *ast, AstIndex index) {
+  AstNodeKind kind = ast_node(ast, index)->kind;
+  return kind == AST_INT_LITERAL_EXPRESSION ||
+         kind == AST_CONSTANT_EXPRESSION;
+}
+
+// Helper function to convert an expression which must be a String.
+LLVMValueRef convert_string_operand(Codegen *codegen, AstIndex index,
+                                    Token operator) {
+  TypedValue value = convert_expression(codegen, index, TOKEN_EOF);
+  if (value.type != TOKEN_STRING) {
+    fprintf(stderr, "Error: '%.*s' expects a String but got %s (line %zu)\n",
+            (int)operator.length, operator.start_ptr, type_name(value.type),
+            operator.line);
+    exit(1);
+  }
+  return value.value;
+}
+
+// Helper function to convert an expression which must be a vector.
+TypedValue convert_vector_operand(Codegen *codegen, AstIndex index,
+                                  Token operator) {
+  TypedValue value = convert_expression(codegen, index, TOKEN_EOF);
+  if (!is_vector_type(value.type)) {
+    fprintf(stderr, "Error: '%.*s' expects a vector but got %s (line %zu)\n",
+            (int)operator.length, operator.start_ptr, type_name(value.type),
+            operator.line);
+    exit(1);
+  }
+  return value;
+}
+
+// Helper function to convert an index into a String or vector to an i64.
+LLVMValueRef convert_offset(Codegen *codegen, AstIndex index,
+                                   size_t line) {
+  TypedValue value = convert_expression(codegen, index, TOKEN_I64);
+  if (!is_integer_type(value.type)) {
+    fprintf(stderr, "Error: Expected an integer index but got %s (line %zu)\n",
+            type_name(value.type), line);
+    exit(1);
+  }
+  return resize_integer(codegen, value, TOKEN_I64);
+}
+
+// Helper function to call an intrinsic which is not overloaded.
+LLVMValueRef build_intrinsic_call(Codegen *codegen, const char *name,
+                                  LLVMValueRef *args, unsigned arg_count) {
+  unsigned id = LLVMLookupIntrinsicID(name, strlen(name));
+  LLVMTypeRef function_type =
+      LLVMIntrinsicGetType(codegen->llvm_context, id, NULL, 0);
+  LLVMValueRef function =
+      LLVMGetIntrinsicDeclaration(codegen->llvm_module, id, NULL, 0);
+  return LLVMBuildCall2(codegen->builder, function_type, function, args,
+                        arg_count, "");
+}
+
+// Helper function to check a condition an operation relies on. A condition
+// folded to false is reported right away with the message. Any other
+// condition is checked at run time, trapping when it does not hold. A
+// vector condition must hold in every lane.
+void check_condition(Codegen *codegen, LLVMValueRef condition,
+                     const char *message, size_t line) {
+  LLVMBuilderRef builder = codegen->builder;
+  LLVMTypeRef condition_type = LLVMTypeOf(condition);
+  if (LLVMGetTypeKind(condition_type) == LLVMVectorTypeKind) {
+    LLVMTypeRef mask_type = LLVMIntTypeInContext(
+        codegen->llvm_context, LLVMGetVectorSize(condition_type));
+    condition = LLVMBuildICmp(
+        builder, LLVMIntEQ,
+        LLVMBuildBitCast(builder, condition, mask_type, "lanes"),
+        LLVMConstAllOnes(mask_type), "all_lanes");
+  }
+
+  if (LLVMIsAConstantInt(condition)) {
+    if (LLVMConstIntGetZExtValue(condition)) {
+      return;
+    }
+    fprintf(stderr, "Error: %s (line %zu)\n", message, line);
+    exit(1);
+  }
+
+  LLVMValueRef function = LLVMGetBasicBlockParent(LLVMGetInsertBlock(builder));
+  LLVMBasicBlockRef trap_block = LLVMAppendBasicBlockInContext(
+      codegen->llvm_context, function, "out_of_range");
+  LLVMBasicBlockRef end_block = LLVMAppendBasicBlockInContext(
+      codegen->llvm_context, function, "in_range");
+  LLVMBuildCondBr(builder, condition, end_block, trap_block);
+
+  LLVMPositionBuilderAtEnd(builder, trap_block);
+  build_intrinsic_call(codegen, "llvm.trap", NULL, 0);
+  LLVMBuildUnreachable(builder);
+
+  LLVMPositionBuilderAtEnd(builder, end_block);
+}
+
+// Helper function to check that an index or slice lies within a String or
+// vector, see check_condition.
+void check_in_range(Codegen *codegen, LLVMValueRef condition,
+                    const char *what, size_t line) {
+  char message[64];
+  snprintf(message, sizeof(message), "%s is out of range", what);
+  check_condition(codegen, condition, message, line);
+}
+
+// Helper function to check the argument count of a predeclared function.
+void check_builtin_arguments(const AstNode *node, Token name,
+                             unsigned expected_count) {
+  if (node->rhs - node->lhs != expected_count) {
+    fprintf(stderr,
+            "Error: Function '%.*s' expects %u arguments but got %u "
+            "(line %zu)\n",
+            (int)name.length, name.start_ptr, expected_count,
+            node->rhs - node->lhs, name.line);
+    exit(1);
+  }
+}
+
+// Helper function to convert `len(s)`, the length of a String.
+TypedValue convert_len(Codegen *codegen, const AstNode *node, Token name) {
+  check_builtin_arguments(node, name, 1);
+
+  LLVMValueRef string = convert_string_operand(
+      codegen, codegen->ast->extra.data[node->lhs], name);
+  return (TypedValue){
+      .value = LLVMBuildExtractValue(codegen->builder, string, 1, "len"),
+      .type = TOKEN_I64};
+}
+
+// Helper function to convert `shuffle(a, i...)` and `shuffle(a, b, i...)`,
+// which pick every lane of the result by a constant index into the lanes
+// of a, followed by those of b.
+TypedValue convert_shuffle(Codegen *codegen, const AstNode *node,
+                           Token name) {
+  const Ast *ast = codegen->ast;
+  unsigned arg_count = node->rhs - node->lhs;
+  if (arg_count == 0) {
+    check_builtin_arguments(node, name, 1);
+  }
+
+  TypedValue a =
+      convert_vector_operand(codegen, ast->extra.data[node->lhs], name);
+  unsigned lane_count = vector_lane_count(a.type);
+  if (arg_count != lane_count + 1 && arg_count != lane_count + 2) {
+    fprintf(stderr,
+            "Error: Function 'shuffle' of %s expects %u or %u arguments but "
+            "got %u (line %zu)\n",
+            type_name(a.type), lane_count + 1, lane_count + 2, arg_count,
+            name.line);
+    exit(1);
+  }
+
+  LLVMValueRef b = LLVMGetUndef(llvm_type_of(codegen, a.type));
+  uint32_t indices_start = node->lhs + 1;
+  if (arg_count == lane_count + 2) {
+    TypedValue value =
+        convert_expression(codegen, ast->extra.data[indices_start], a.type);
+    b = convert_to_type(codegen, value, a.type, name.line);
+    indices_start++;
+  }
+
+  // Shuffle masks are constants, so the indices must be known here.
+  unsigned limit = (arg_count - lane_count) * lane_count;
+  LLVMValueRef mask[32];
+  for (unsigned i = 0; i < lane_count; i++) {
+    AstIndex index = ast->extra.data[indices_start + i];
+    if (!is_untyped_constant(ast, index)) {
+      fprintf(stderr,
+              "Error: The lane indices of 'shuffle' must be constants "
+              "(line %zu)\n",
+              name.line);
+      exit(1);
+    }
+
+    mask[i] = convert_expression(codegen, index, TOKEN_U32).value;
+    if (LLVMConstIntGetZExtValue(mask[i]) >= limit) {
+      fprintf(stderr,
+              "Error: Lane %llu is out of range for 'shuffle' of %s "
+              "(line %zu)\n",
+              LLVMConstIntGetZExtValue(mask[i]), type_name(a.type),
+              name.line);
+      exit(1);
+    }
+  }
+
+  return (TypedValue){
+      .value = LLVMBuildShuffleVector(codegen->builder, a.value, b,
+                                      LLVMConstVector(mask, lane_count),
+                                      "shuffle"),
+      .type = a.type};
+}
+
+// Helper function to convert `reduce_<operation>(v)`, which combines the
+// lanes of a vector into one value of the lane type. Sums and products
+// wrap around like the operators do.
+TypedValue convert_reduce(Codegen *codegen, const AstNode *node, Token name,
+                          const char *operation) {
+  check_builtin_arguments(node, name, 1);
+  TypedValue vector = convert_vector_operand(
+      codegen, codegen->ast->extra.data[node->lhs], name);
+  TokenKind element_type = vector_element_type(vector.type);
+
+  // The minimum and maximum depend on the signedness of the lanes.
+  char intrinsic[32];
+  bool is_ordered = strcmp(operation, "min") == 0 ||
+                    strcmp(operation, "max") == 0;
+  snprintf(intrinsic, sizeof(intrinsic), "llvm.vector.reduce.%s%s",
+           !is_ordered                           ? ""
+           : is_signed_integer_type(element_type) ? "s"
+                                                  : "u",
+           operation);
+
+  unsigned id = LLVMLookupIntrinsicID(intrinsic, strlen(intrinsic));
+  LLVMTypeRef vector_type = llvm_type_of(codegen, vector.type);
+  LLVMValueRef function = LLVMGetIntrinsicDeclaration(codegen->llvm_module,
+                                                      id, &vector_type, 1);
+  LLVMTypeRef function_type =
+      LLVMIntrinsicGetType(codegen->llvm_context, id, &vector_type, 1);
+  return (TypedValue){.value = LLVMBuildCall2(codegen->builder,
+                                              function_type, function,
+                                              &vector.value, 1, "reduce"),
+                      .type = element_type};
+}
+
+// Helper function to convert a call to a predeclared function. Like Go's,
+// they only apply when no function of that name is declared. Returns false
+// when the name is none of them.
+bool convert_builtin(Codegen *codegen, const AstNode *node, Token name,
+                     TypedValue *result) {
+  static const char *const reductions[] = {"add", "mul", "and", "or",
+                                           "xor", "min", "max"};
+
+  if (name.length == 3 && memcmp(name.start_ptr, "len", 3) == 0) {
+    *result = convert_len(codegen, node, name);
+    return true;
+  }
+  if (name.length == 7 && memcmp(name.start_ptr, "shuffle", 7) == 0) {
+    *result = convert_shuffle(codegen, node, name);
+    return true;
+  }
+  if (name.length > 7 && memcmp(name.start_ptr, "reduce_", 7) == 0) {
+    for (size_t i = 0; i < sizeof(reductions) / sizeof(reductions[0]); i++) {
+      if (name.length - 7 == strlen(reductions[i]) &&
+          memcmp(name.start_ptr + 7, reductions[i], name.length - 7) == 0) {
+        *result = convert_reduce(codegen, node, name, reductions[i]);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Helper function to convert `s[i]`, the byte at an offset of a String, or
+// `v[i]`, a lane of a vector. The offset is checked against the lane count
+// or the length of the String, see check_in_range.
+TypedValue convert_index(Codegen *codegen, const AstNode *node) {
+  Token bracket = ast_token(codegen->ast, node->main_token);
+  TypedValue operand = convert_expression(codegen, node->lhs, TOKEN_EOF);
+  LLVMValueRef offset = convert_offset(codegen, node->rhs, bracket.line);
+
+  if (is_vector_type(operand.type)) {
+    if (LLVMIsAConstantInt(offset) &&
+        LLVMConstIntGetZExtValue(offset) >= vector_lane_count(operand.type)) {
+      fprintf(stderr, "Error: Lane %llu is out of range for %s (line %zu)\n",
+              LLVMConstIntGetZExtValue(offset), type_name(operand.type),
+              bracket.line);
+      exit(1);
+    }
+
+    // A lane past the end would give poison rather than reading memory,
+    // it traps all the same like an offset into a String.
+    LLVMValueRef lane_count =
+        LLVMConstInt(LLVMInt64TypeInContext(codegen->llvm_context),
+                     vector_lane_count(operand.type), false);
+    check_in_range(codegen,
+                   LLVMBuildICmp(codegen->builder, LLVMIntULT, offset,
+                                 lane_count, "in_range"),
+                   "Lane", bracket.line);
+    return (TypedValue){.value = LLVMBuildExtractElement(
+                            codegen->builder, operand.value, offset, "lane"),
+                        .type = vector_element_type(operand.type)};
+  }
+  if (operand.type != TOKEN_STRING) {
+    fprintf(stderr,
+            "Error: '[' expects a String or vector but got %s (line %zu)\n",
+            type_name(operand.type), bracket.line);
+    exit(1);
+  }
+
+  // Offsets are unsigned here, so a negative one is out of range as well.
+  LLVMValueRef length =
+      LLVMBuildExtractValue(codegen->builder, operand.value, 1, "str_len");
+  check_in_range(
+      codegen,
+      LLVMBuildICmp(codegen->builder, LLVMIntULT, offset, length, "in_range"),
+      "Index", bracket.line);
+
+  LLVMTypeRef i8 = LLVMInt8TypeInContext(codegen->llvm_context);
+  LLVMValueRef data =
+      LLVMBuildExtractValue(codegen->builder, operand.value, 0, "str_data");
+  LLVMValueRef address =
+      LLVMBuildInBoundsGEP2(codegen->builder, i8, data, &offset, 1, "byte");
+  return (TypedValue){
+      .value = LLVMBuildLoad2(codegen->builder, i8, address, "byte"),
+      .type = TOKEN_U8};
+}
+
+// Helper function to convert a vector type called like a function. One
+// value per lane builds the vector. A single value is put in every lane,
+// or converts each lane of a vector with as many lanes, or loads the first
+// bytes of a String, which must hold at least the size of the vector; a
+// shorter String traps, see check_in_range.
+TypedValue convert_vector(Codegen *codegen, const AstNode *node) {
+  const Ast *ast = codegen->ast;
+  LLVMBuilderRef builder = codegen->builder;
+  Token type_token = ast_token(ast, node->main_token);
+  TokenKind type = type_token.kind;
+  TokenKind element_type = vector_element_type(type);
+  unsigned lane_count = vector_lane_count(type);
+  unsigned value_count = node->rhs - node->lhs;
+  LLVMTypeRef llvm_type = llvm_type_of(codegen, type);
+  LLVMTypeRef i32 = LLVMInt32TypeInContext(codegen->llvm_context);
+
+  if (value_count == 1) {
+    // A literal operand is put in every lane directly.
+    TypedValue value =
+        convert_expression(codegen, ast->extra.data[node->lhs], type);
+    if (value.type == TOKEN_STRING) {
+      LLVMValueRef size =
+          LLVMConstInt(LLVMInt64TypeInContext(codegen->llvm_context),
+                       lane_count * integer_type_width(element_type) / 8,
+                       false);
+      LLVMValueRef length =
+          LLVMBuildExtractValue(builder, value.value, 1, "str_len");
+      check_in_range(
+          codegen, LLVMBuildICmp(builder, LLVMIntUGE, length, size, "in_range"),
+          "Vector load", type_token.line);
+
+      LLVMValueRef data =
+          LLVMBuildExtractValue(builder, value.value, 0, "str_data");
+      LLVMValueRef address = LLVMBuildBitCast(
+          builder, data, LLVMPointerType(llvm_type, 0), "vector_data");
+      LLVMValueRef load = LLVMBuildLoad2(builder, llvm_type, address, "load");
+      LLVMSetAlignment(load, 1);
+      return (TypedValue){.value = load, .type = type};
+    }
+    if (is_vector_type(value.type)) {
+      if (vector_lane_count(value.type) != lane_count) {
+        fprintf(stderr, "Error: Cannot convert %s to %s (line %zu)\n",
+                type_name(value.type), type_name(type), type_token.line);
+        exit(1);
+      }
+      return (TypedValue){.value = resize_integer(codegen, value, type),
+                          .type = type};
+    }
+
+    LLVMValueRef lane =
+        convert_to_type(codegen, value, element_type, type_token.line);
+    LLVMValueRef vector = LLVMBuildInsertElement(
+        builder, LLVMGetUndef(llvm_type), lane, LLVMConstInt(i32, 0, false),
+        "");
+    return (TypedValue){
+        .value = LLVMBuildShuffleVector(
+            builder, vector, LLVMGetUndef(llvm_type),
+            LLVMConstNull(LLVMVectorType(i32, lane_count)), "splat"),
+        .type = type};
+  }
+
+  if (value_count != lane_count) {
+    fprintf(stderr, "Error: %s expects 1 or %u values but got %u (line %zu)\n",
+            type_name(type), lane_count, value_count, type_token.line);
+    exit(1);
+  }
+
+  LLVMValueRef vector = LLVMGetUndef(llvm_type);
+  for (unsigned i = 0; i < lane_count; i++) {
+    TypedValue value = convert_expression(
+        codegen, ast->extra.data[node->lhs + i], element_type);
+    LLVMValueRef lane =
+        convert_to_type(codegen, value, element_type, type_token.line);
+    vector = LLVMBuildInsertElement(builder, vector, lane,
+                                    LLVMConstInt(i32, i, false), "");
+  }
+  return (TypedValue){.value = vector, .type = type};
+}
+
+// Helper function to convert `s[start:end]`. The slice shares the
+// characters of the String, so taking one copies nothing, and it is not
+// followed by a terminator. The bounds must satisfy
+// 0 <= start <= end <= len(s), see check_in_range.
+TypedValue convert_slice(Codegen *codegen, const AstNode *node) {
+  const Ast *ast = codegen->ast;
+  Token bracket = ast_token(ast, node->main_token);
+  AstIndex start_index = ast->extra.data[node->rhs];
+  AstIndex end_index = ast->extra.data[node->rhs + 1];
+  LLVMValueRef string = convert_string_operand(codegen, node->lhs, bracket);
+
+  LLVMTypeRef i64 = LLVMInt64TypeInContext(codegen->llvm_context);
+  LLVMValueRef start =
+      start_index != AST_NONE
+          ? convert_offset(codegen, start_index, bracket.line)
+          : LLVMConstInt(i64, 0, false);
+  LLVMValueRef length =
+      LLVMBuildExtractValue(codegen->builder, string, 1, "str_len");
+  LLVMValueRef end = end_index != AST_NONE
+                         ? convert_offset(codegen, end_index, bracket.line)
+                         : length;
+
+  // Bounds are unsigned here, so a negative one is out of range as well.
+  LLVMValueRef in_range = LLVMBuildAnd(
+      codegen->builder,
+      LLVMBuildICmp(codegen->builder, LLVMIntULE, start, end, "start_in_range"),
+      LLVMBuildICmp(codegen->builder, LLVMIntULE, end, length, "end_in_range"),
+      "in_range");
+  check_in_range(codegen, in_range, "Slice", bracket.line);
+
+  LLVMValueRef data =
+      LLVMBuildExtractValue(codegen->builder, string, 0, "str_data");
+  LLVMValueRef slice_data = LLVMBuildInBoundsGEP2(
+      codegen->builder, LLVMInt8TypeInContext(codegen->llvm_context), data,
+      &start, 1, "slice_data");
+  LLVMValueRef slice_length =
+      LLVMBuildNUWSub(codegen->builder, end, start, "slice_len");
+
+  LLVMValueRef slice = LLVMGetUndef(llvm_type_of(codegen, TOKEN_STRING));
+  slice = LLVMBuildInsertValue(codegen->builder, slice, slice_data, 0, "");
+  slice =
+      LLVMBuildInsertValue(codegen->builder, slice, slice_length, 1, "slice");
+  return (TypedValue){.value = slice, .type = TOKEN_STRING};
+}
+
+// Helper function to obtain the characters of a String for C code which
+// reads up to a terminator. A literal is followed by one, but a slice
+// usually is not, so a String whose byte at its length is not zero is
+// copied to the stack and terminated there. That byte is always readable,
+// as slices stay within their String. The stack is saved in *stack before
+// the first copy, for the caller to restore once C is done with it.
+LLVMValueRef convert_terminated_string(Codegen *codegen, AstIndex index,
+                                       LLVMValueRef string,
+                                       LLVMValueRef *stack) {
+  LLVMBuilderRef builder = codegen->builder;
+  LLVMValueRef data = LLVMBuildExtractValue(builder, string, 0, "str_data");
+  if (ast_node(codegen->ast, index)->kind == AST_STRING_LITERAL_EXPRESSION) {
+    return data;
+  }
+
+  if (!*stack) {
+    *stack = build_intrinsic_call(codegen, "llvm.stacksave", NULL, 0);
+  }
+
+  LLVMTypeRef i8 = LLVMInt8TypeInContext(codegen->llvm_context);
+  LLVMValueRef length = LLVMBuildExtractValue(builder, string, 1, "str_len");
+  LLVMValueRef end =
+      LLVMBuildInBoundsGEP2(builder, i8, data, &length, 1, "str_end");
+  LLVMValueRef is_terminated =
+      LLVMBuildICmp(builder, LLVMIntEQ, LLVMBuildLoad2(builder, i8, end, ""),
+                    LLVMConstInt(i8, 0, false), "is_terminated");
+
+  LLVMBasicBlockRef block = LLVMGetInsertBlock(builder);
+  LLVMValueRef function = LLVMGetBasicBlockParent(block);
+  LLVMBasicBlockRef copy_block = LLVMAppendBasicBlockInContext(
+      codegen->llvm_context, function, "terminate");
+  LLVMBasicBlockRef end_block = LLVMAppendBasicBlockInContext(
+      codegen->llvm_context, function, "terminated");
+  LLVMBuildCondBr(builder, is_terminated, end_block, copy_block);
+
+  LLVMPositionBuilderAtEnd(builder, copy_block);
+  LLVMValueRef size = LLVMBuildAdd(
+      builder, length,
+      LLVMConstInt(LLVMInt64TypeInContext(codegen->llvm_context), 1, false),
+      "");
+  LLVMValueRef copy = LLVMBuildArrayAlloca(builder, i8, size, "str_copy");
+  LLVMBuildMemCpy(builder, copy, 1, data, 1, length);
+  LLVMBuildStore(
+      builder, LLVMConstInt(i8, 0, false),
+      LLVMBuildInBoundsGEP2(builder, i8, copy, &length, 1, "str_copy_end"));
+  LLVMBuildBr(builder, end_block);
+
+  LLVMPositionBuilderAtEnd(builder, end_block);
+  LLVMValueRef phi =
+      LLVMBuildPhi(builder, LLVMTypeOf(data), "terminated_data");
+  LLVMValueRef values[] = {data, copy};
+  LLVMBasicBlockRef blocks[] = {block, copy_block};
+  LLVMAddIncoming(phi, values, blocks, 2);
+  return phi;
+}
+
+// Helper function to convert a call, typing the arguments by the callee's
+// declaration.
+TypedValue convert_call(Codegen *codegen, AstIndex index) {
+  const Ast *ast = codegen->ast;
+  const AstNode *node = ast_node(ast, index);
+  Token fn_name = ast_token(ast, node->main_token);
+
+  LLVMValueRef function = resolve_function(codegen, fn_name);
+  TypedValue builtin_result;
+  if (!function && convert_builtin(codegen, node, fn_name, &builtin_result)) {
+    return builtin_result;
+  }
+  if (!function) {
+    fprintf(stderr, "Error: Function '%.*s' not found\n", (int)fn_name.length,
+            fn_name.start_ptr);
+    exit(1);
+  }
+
+  const DeclarationEntry *entry =
+      declaration_table_slot(codegen->declarations, fn_name.intern_id);
+  const Ast *callee_ast = &codegen->asts[entry->unit];
+  const AstNode *callee = ast_node(callee_ast, entry->node);
+  bool is_foreign = callee->kind == AST_FOREIGN_DECLARATION;
+  uint32_t params_start, params_end;
+  ast_declaration_parameters(callee_ast, callee, &params_start, &params_end);
+
+  // The tail parameter is a fixed LLVM parameter, like the format of
+  // printf, so it needs an argument of its own. Any number of further
+  // arguments may follow it, including none.
+  unsigned param_count = params_end - params_start;
+  unsigned arg_count = node->rhs - node->lhs;
+  bool has_tail = LLVMIsFunctionVarArg(LLVMGlobalGetValueType(function));
+  if (has_tail ? arg_count < param_count : arg_count != param_count) {
+    fprintf(stderr,
+            "Error: Function '%.*s' expects %s%u arguments but got %u "
+            "(line %zu)\n",
+            (int)fn_name.length, fn_name.start_ptr,
+            has_tail ? "at least " : "", param_count, arg_count,
+            fn_name.line);
+    exit(1);
+  }
+
+  // A @sized String takes two LLVM arguments. Copies of Strings made to
+  // terminate them live on the stack until the call returns.
+  LLVMValueRef *args = NULL;
+  unsigned llvm_arg_count = 0;
+  LLVMValueRef stack = NULL;
+  if (arg_count > 0) {
+    args = malloc(2 * arg_count * sizeof(LLVMValueRef));
+  }
+
+  for (unsigned i = 0; i < arg_count; i++) {
+    AstIndex arg = ast->extra.data[node->lhs + i];
+    if (i < param_count) {
+      const AstNode *param =
+          ast_node(callee_ast, callee_ast->extra.data[params_start + i]);
+      TokenKind param_type =
+          (TokenKind)callee_ast->tokens.kinds[param->main_token];
+
+      TypedValue value = convert_expression(codegen, arg, param_type);
+      LLVMValueRef converted =
+          convert_to_type(codegen, value, param_type, fn_name.line);
+
+      // C receives the characters of a `String` and their count when the
+      // parameter is @sized, so it never has to look for a terminator.
+      // Otherwise it gets terminated characters.
+      if (param_type == TOKEN_STRING && is_foreign) {
+        if (!(param->rhs & AST_PARAMETER_SIZED)) {
+          args[llvm_arg_count++] =
+              convert_terminated_string(codegen, arg, converted, &stack);
+          continue;
+        }
+        args[llvm_arg_count++] =
+            LLVMBuildExtractValue(codegen->builder, converted, 0, "str_data");
+        converted =
+            LLVMBuildExtractValue(codegen->builder, converted, 1, "str_len");
+      }
+      args[llvm_arg_count++] = converted;
+      continue;
+    }
+
+    // Arguments to a tail parameter get C's default promotions.
+    TypedValue value = convert_expression(codegen, arg, TOKEN_EOF);
+    if (value.type == TOKEN_STRING) {
+      args[llvm_arg_count++] =
+          convert_terminated_string(codegen, arg, value.value, &stack);
+    } else if ((is_integer_type(value.type) || value.type == TOKEN_BOOL) &&
+               integer_type_width(value.type) < 32) {
+      args[llvm_arg_count++] = resize_integer(
+          codegen, value,
+          is_signed_integer_type(value.type) ? TOKEN_I32 : TOKEN_U32);
+    } else {
+      args[llvm_arg_count++] = value.value;
+    }
+  }
+
+  LLVMValueRef call_result =
+      LLVMBuildCall2(codegen->builder, LLVMGlobalGetValueType(function),
+                     function, args, llvm_arg_count, "");
+  if (stack) {
+    build_intrinsic_call(codegen, "llvm.stackrestore", &stack, 1);
+  }
+
+  TokenKind return_type =
+      (TokenKind)callee_ast->tokens.kinds[callee->main_token];
+  if (is_foreign) {
+    add_extension_attribute(codegen, call_result, LLVMAttributeReturnIndex,
+                            return_type, true);
+    unsigned llvm_index = 1;
+    for (unsigned i = 0; i < param_count; i++) {
+      const AstNode *param =
+          ast_node(callee_ast, callee_ast->extra.data[params_start + i]);
+      add_extension_attribute(
+          codegen, call_result, llvm_index,
+          (TokenKind)callee_ast->tokens.kinds[param->main_token], true);
+      llvm_index += param->rhs & AST_PARAMETER_SIZED ? 2 : 1;
+    }
+  }
+
+  if (args)
+    free(args);
+
+  return (TypedValue){.value = call_result, .type = return_type};
+}
+
+// Helper function to lower an integer constant, given by its sign and
+// magnitude. It takes the expected type, or i32 (i64 when too large) like
+// C's int when the context expects none. A vector context gets the
+// constant in every lane.
+TypedValue convert_integer_constant(Codegen *codegen, bool negative,
+                                    unsigned long long magnitude,
+                                    TokenKind expected_type, size_t line) {
+  if (is_vector_type(expected_type)) {
+    TypedValue lane = convert_integer_constant(
+        codegen, negative, magnitude, vector_element_type(expected_type),
+        line);
+    LLVMValueRef lanes[32];
+    unsigned lane_count = vector_lane_count(expected_type);
+    for (unsigned i = 0; i < lane_count; i++) {
+      lanes[i] = lane.value;
+    }
+    return (TypedValue){.value = LLVMConstVector(lanes, lane_count),
+                        .type = expected_type};
+  }
+
+  TokenKind type = TOKEN_I32;
+  if (is_integer_type(expected_type)) {
+    type = expected_type;
+  } else if (!integer_constant_fits(negative, magnitude, type)) {
+    type = TOKEN_I64;
+  }
+
+  if (!integer_constant_fits(negative, magnitude, type)) {
+    fprintf(stderr, "Error: %s%llu does not fit in %s (line %zu)\n",
+            negative ? "-" : "", magnitude, type_name(type), line);
+    exit(1);
+  }
+
+  // LLVM keeps the low bits, which is the two's complement for negatives.
+  unsigned long long bits = negative ? 0 - magnitude : magnitude;
+  return (TypedValue){
+      .value = LLVMConstInt(llvm_type_of(codegen, type), bits, false),
+      .type = type};
+}
+
+// Helper function to report an operator used on a type it does not take.
+void check_operand_type(Token operator, TokenKind type, bool is_allowed) {
+  if (!is_allowed) {
+    fprintf(stderr,
+            "Error: Operator '%.*s' cannot be applied to %s (line %zu)\n",
+            (int)operator.length, operator.start_ptr, type_name(type),
+            operator.line);
+    exit(1);
+  }
+}
+
+// Helper function to lower a unary expression.
+TypedValue convert_unary(Codegen *codegen, const AstNode *node,
+                         TokenKind expected_type) {
+  Token operator = ast_token(codegen->ast, node->main_token);
+  TypedValue operand = convert_expression(codegen, node->lhs, expected_type);
+
+  switch (operator.kind) {
+  case TOKEN_MINUS:
+    check_operand_type(operator, operand.type,
+                       is_signed_integer_type(scalar_type(operand.type)));
+    operand.value = LLVMBuildNeg(codegen->builder, operand.value, "neg");
+    break;
+  case TOKEN_TILDE:
+    check_operand_type(operator, operand.type,
+                       is_integer_type(scalar_type(operand.type)));
+    operand.value = LLVMBuildNot(codegen->builder, operand.value, "not");
+    break;
+  default: // TOKEN_BANG
+    check_operand_type(operator, operand.type, operand.type == TOKEN_BOOL);
+    operand.value = LLVMBuildNot(codegen->builder, operand.value, "not");
+    break;
+  }
+
+  return operand;
+}
+
+// Helper function to lower both operands of a binary expression to one
+// type. An untyped constant takes the type of the other operand, and an
+// integer is widened to the type of the other one when that is lossless.
+void convert_operands(Codegen *codegen, const AstNode *node,
+                      TokenKind expected_type, TypedValue *lhs,
+                      TypedValue *rhs) {
+  const Ast *ast = codegen->ast;
+  if (is_untyped_constant(ast, node->lhs) &&
+      !is_untyped_constant(ast, node->rhs)) {
+    // Evaluating the constant last changes no side effects.
+    *rhs = convert_expression(codegen, node->rhs, expected_type);
+    *lhs = convert_expression(codegen, node->lhs, rhs->type);
+  } else {
+    *lhs = convert_expression(codegen, node->lhs, expected_type);
+    *rhs = convert_expression(codegen, node->rhs, lhs->type);
+  }
+
+  if (lhs->type != rhs->type && is_integer_type(lhs->type) &&
+      is_integer_type(rhs->type)) {
+    if (is_widening_conversion(lhs->type, rhs->type)) {
+      lhs->value = resize_integer(codegen, *lhs, rhs->type);
+      lhs->type = rhs->type;
+    } else if (is_widening_conversion(rhs->type, lhs->type)) {
+      rhs->value = resize_integer(codegen, *rhs, lhs->type);
+      rhs->type = lhs->type;
+    }
+  }
+
+  if (lhs->type != rhs->type) {
+    Token operator = ast_token(ast, node->main_token);
+    fprintf(stderr,
+            "Error: Operator '%.*s' cannot combine %s and %s (line %zu)\n",
+            (int)operator.length, operator.start_ptr, type_name(lhs->type),
+            type_name(rhs->type), operator.line);
+    exit(1);
+  }
+}
+
+// Helper function to lower `&&` and `||`, which only evaluate their right
+// operand when the left one does not decide the result.
+TypedValue convert_logical(Codegen *codegen, const AstNode *node) {
+  LLVMBuilderRef builder = codegen->builder;
+  Token operator = ast_token(codegen->ast, node->main_token);
+  bool is_and = operator.kind == TOKEN_AND_AND;
+
+  TypedValue lhs = convert_expression(codegen, node->lhs, TOKEN_BOOL);
+  check_operand_type(operator, lhs.type, lhs.type == TOKEN_BOOL);
+  LLVMBasicBlockRef lhs_block = LLVMGetInsertBlock(builder);
+  LLVMValueRef function = LLVMGetBasicBlockParent(lhs_block);
+  LLVMBasicBlockRef rhs_block = LLVMAppendBasicBlockInContext(
+      codegen->llvm_context, function, is_and ? "and.rhs" : "or.rhs");
+  LLVMBasicBlockRef end_block = LLVMAppendBasicBlockInContext(
+      codegen->llvm_context, function, is_and ? "and.end" : "or.end");
+  if (is_and) {
+    LLVMBuildCondBr(builder, lhs.value, rhs_block, end_block);
+  } else {
+    LLVMBuildCondBr(builder, lhs.value, end_block, rhs_block);
+  }
+
+  LLVMPositionBuilderAtEnd(builder, rhs_block);
+  TypedValue rhs = convert_expression(codegen, node->rhs, TOKEN_BOOL);
+  check_operand_type(operator, rhs.type, rhs.type == TOKEN_BOOL);
+  LLVMBasicBlockRef rhs_end_block = LLVMGetInsertBlock(builder);
+  LLVMBuildBr(builder, end_block);
+
+  // Skipping the right operand leaves the value of the left one.
+  LLVMPositionBuilderAtEnd(builder, end_block);
+  LLVMTypeRef bool_type = llvm_type_of(codegen, TOKEN_BOOL);
+  LLVMValueRef phi = LLVMBuildPhi(builder, bool_type, is_and ? "and" : "or");
+  LLVMValueRef values[] = {LLVMConstInt(bool_type, !is_and, false),
+                           rhs.value};
+  LLVMBasicBlockRef blocks[] = {lhs_block, rhs_end_block};
+  LLVMAddIncoming(phi, values, blocks, 2);
+  return (TypedValue){.value = phi, .type = TOKEN_BOOL};
+}
+
+// Helper function to obtain an integer constant of an integer or vector
+// type, with the value in every lane of a vector.
+LLVMValueRef integer_constant_of_type(Codegen *codegen, TokenKind type,
+                                      unsigned long long value) {
+  LLVMValueRef lane =
+      LLVMConstInt(llvm_type_of(codegen, scalar_type(type)), value, false);
+  if (!is_vector_type(type)) {
+    return lane;
+  }
+
+  LLVMValueRef lanes[32];
+  unsigned lane_count = vector_lane_count(type);
+  for (unsigned i = 0; i < lane_count; i++) {
+    lanes[i] = lane;
+  }
+  return LLVMConstVector(lanes, lane_count);
+}
+
+// Helper function to check the divisor of `/` and `%`. It must not be
+// zero, nor -1 with the smallest signed dividend, as the quotient would not
+// fit. Both are undefined in LLVM, so they trap instead, see
+// check_condition.
+void check_divisor(Codegen *codegen, TypedValue lhs, TypedValue rhs,
+                   size_t line) {
+  LLVMBuilderRef builder = codegen->builder;
+  LLVMValueRef zero = LLVMConstNull(LLVMTypeOf(rhs.value));
+  check_condition(
+      codegen, LLVMBuildICmp(builder, LLVMIntNE, rhs.value, zero, "nonzero"),
+      "Division by zero", line);
+
+  TokenKind type = scalar_type(lhs.type);
+  if (!is_signed_integer_type(type)) {
+    return;
+  }
+
+  // Most divisors are constants other than -1, which need no check.
+  LLVMValueRef minus_one = LLVMConstAllOnes(LLVMTypeOf(rhs.value));
+  LLVMValueRef is_minus_one =
+      LLVMBuildICmp(builder, LLVMIntEQ, rhs.value, minus_one, "minus_one");
+  if (LLVMIsConstant(is_minus_one) && LLVMIsNull(is_minus_one)) {
+    return;
+  }
+
+  LLVMValueRef minimum = integer_constant_of_type(
+      codegen, lhs.type, 1ULL << (integer_type_width(type) - 1));
+  LLVMValueRef fits = LLVMBuildOr(
+      builder,
+      LLVMBuildICmp(builder, LLVMIntNE, lhs.value, minimum, "not_minimum"),
+      LLVMBuildICmp(builder, LLVMIntNE, rhs.value, minus_one,
+                    "not_minus_one"),
+      "fits");
+  check_condition(codegen, fits, "Division overflows", line);
+}
+
+// Helper function to lower `<<` and `>>`. The result has the type of the
+// left operand, the shift amount is resized to it. A vector is shifted by
+// a vector of the same type, lane by lane. Shifting by the bit width or
+// more, or by a negative amount, traps, see check_condition.
+TypedValue convert_shift(Codegen *codegen, const AstNode *node,
+                         TokenKind expected_type) {
+  Token operator = ast_token(codegen->ast, node->main_token);
+  TypedValue lhs = convert_expression(codegen, node->lhs, expected_type);
+  check_operand_type(operator, lhs.type,
+                     is_integer_type(scalar_type(lhs.type)));
+  TypedValue rhs = convert_expression(codegen, node->rhs, lhs.type);
+  check_operand_type(operator, rhs.type,
+                     is_vector_type(lhs.type) ? rhs.type == lhs.type
+                                              : is_integer_type(rhs.type));
+
+  // The amount is checked before it is resized, so the bits cut off are
+  // checked too. Compared unsigned, a negative amount is out of range.
+  LLVMValueRef width = integer_constant_of_type(
+      codegen, rhs.type, integer_type_width(scalar_type(lhs.type)));
+  check_in_range(codegen,
+                 LLVMBuildICmp(codegen->builder, LLVMIntULT, rhs.value, width,
+                               "in_range"),
+                 "Shift amount", operator.line);
+  LLVMValueRef amount = resize_integer(codegen, rhs, lhs.type);
+
+  if (operator.kind == TOKEN_SHIFT_LEFT) {
+    lhs.value = LLVMBuildShl(codegen->builder, lhs.value, amount, "shl");
+  } else if (is_signed_integer_type(scalar_type(lhs.type))) {
+    lhs.value = LLVMBuildAShr(codegen->builder, lhs.value, amount, "shr");
+  } else {
+    lhs.value = LLVMBuildLShr(codegen->builder, lhs.value, amount, "shr");
+  }
+  return lhs;
+}
+
+// Helper function to lower a comparison to a bool.
+TypedValue convert_comparison(Codegen *codegen, const AstNode *node) {
+  Token operator = ast_token(codegen->ast, node->main_token);
+  TypedValue lhs, rhs;
+  convert_operands(codegen, node, TOKEN_EOF, &lhs, &rhs);
+
+  bool is_equality = operator.kind == TOKEN_EQUAL_EQUAL ||
+                     operator.kind == TOKEN_BANG_EQUAL;
+  check_operand_type(operator, lhs.type,
+                     is_integer_type(lhs.type) ||
+                         (is_equality && lhs.type == TOKEN_BOOL));
+
+  bool is_signed = is_signed_integer_type(lhs.type);
+  LLVMIntPredicate predicate;
+  switch (operator.kind) {
+  case TOKEN_EQUAL_EQUAL:
+    predicate = LLVMIntEQ;
+    break;
+  case TOKEN_BANG_EQUAL:
+    predicate = LLVMIntNE;
+    break;
+  case TOKEN_LESS:
+    predicate = is_signed ? LLVMIntSLT : LLVMIntULT;
+    break;
+  case TOKEN_LESS_EQUAL:
+    predicate = is_signed ? LLVMIntSLE : LLVMIntULE;
+    break;
+  case TOKEN_GREATER:
+    predicate = is_signed ? LLVMIntSGT : LLVMIntUGT;
+    break;
+  default: // TOKEN_GREATER_EQUAL
+    predicate = is_signed ? LLVMIntSGE : LLVMIntUGE;
+    break;
+  }
+
+  return (TypedValue){.value = LLVMBuildICmp(codegen->builder, predicate,
+                                             lhs.value, rhs.value, "cmp"),
+                      .type = TOKEN_BOOL};
+}
+
+// Helper function to lower a binary expression. Integer arithmetic wraps
+// around, division and remainder truncate like in C. A zero divisor, and
+// dividing the smallest signed value by -1, trap, see check_divisor.
+// Vectors of the same type are combined lane by lane.
+TypedValue convert_binary(Codegen *codegen, const AstNode *node,
+                          TokenKind expected_type) {
+  LLVMBuilderRef builder = codegen->builder;
+  Token operator = ast_token(codegen->ast, node->main_token);
+
+  switch (operator.kind) {
+  case TOKEN_AND_AND:
+  case TOKEN_OR_OR:
+    return convert_logical(codegen, node);
+  case TOKEN_SHIFT_LEFT:
+  case TOKEN_SHIFT_RIGHT:
+    return convert_shift(codegen, node, expected_type);
+  case TOKEN_EQUAL_EQUAL:
+  case TOKEN_BANG_EQUAL:
+  case TOKEN_LESS:
+  case TOKEN_LESS_EQUAL:
+  case TOKEN_GREATER:
+  case TOKEN_GREATER_EQUAL:
+    return convert_comparison(codegen, node);
+  default:
+    break;
+  }
+
+  TypedValue lhs, rhs;
+  convert_operands(codegen, node, expected_type, &lhs, &rhs);
+
+  // The bitwise operators also combine bools.
+  bool is_bitwise = operator.kind == TOKEN_AMPERSAND ||
+                    operator.kind == TOKEN_PIPE ||
+                    operator.kind == TOKEN_CARET;
+  check_operand_type(operator, lhs.type,
+                     is_integer_type(scalar_type(lhs.type)) ||
+                         (is_bitwise && lhs.type == TOKEN_BOOL));
+
+  if (operator.kind == TOKEN_SLASH || operator.kind == TOKEN_PERCENT) {
+    check_divisor(codegen, lhs, rhs, operator.line);
+  }
+
+  bool is_signed = is_signed_integer_type(scalar_type(lhs.type));
+  LLVMValueRef value;
+  switch (operator.kind) {
+  case TOKEN_PLUS:
+    value = LLVMBuildAdd(builder, lhs.value, rhs.value, "add");
+    break;
+  case TOKEN_MINUS:
+    value = LLVMBuildSub(builder, lhs.value, rhs.value, "sub");
+    break;
+  case TOKEN_STAR:
+    value = LLVMBuildMul(builder, lhs.value, rhs.value, "mul");
+    break;
+  case TOKEN_SLASH:
+    value = is_signed ? LLVMBuildSDiv(builder, lhs.value, rhs.value, "div")
+                      : LLVMBuildUDiv(builder, lhs.value, rhs.value, "div");
+    break;
+  case TOKEN_PERCENT:
+    value = is_signed ? LLVMBuildSRem(builder, lhs.value, rhs.value, "rem")
+                      : LLVMBuildURem(builder, lhs.value, rhs.value, "rem");
+    break;
+  case TOKEN_AMPERSAND:
+    value = LLVMBuildAnd(builder, lhs.value, rhs.value, "and");
+    break;
+  case TOKEN_PIPE:
+    value = LLVMBuildOr(builder, lhs.value, rhs.value, "or");
+    break;
+  default: // TOKEN_CARET
+    value = LLVMBuildXor(builder, lhs.value, rhs.value, "xor");
+    break;
+  }
+
+  return (TypedValue){.value = value, .type = lhs.type};
+}
+
+// Helper function to convert an expression to IR. Integer constants take
+// the expected type, or i32 (i64 when too large) like C's int when the
+// context expects none, which is written TOKEN_EOF.
+TypedValue convert_expression(Codegen *codegen, AstIndex index,
+                              TokenKind expected_type) {
+  const Ast *ast = codegen->ast;
+  const AstNode *node = ast_node(ast, index);
+
+  switch (node->kind) {
+  case AST_INT_LITERAL_EXPRESSION: {
+    // The literal is always followed by a non-digit character.
+    Token literal = ast_token(ast, node->main_token);
+    errno = 0;
+    unsigned long long value = strtoull(literal.start_ptr, NULL, 10);
+    if (errno == ERANGE) {
+      fprintf(stderr, "Error: %.*s does not fit in 64 bits (line %zu)\n",
+              (int)literal.length, literal.start_ptr, literal.line);
+      exit(1);
+    }
+    return convert_integer_constant(codegen, false, value, expected_type,
+                                    literal.line);
+  }
+
+  case AST_CONSTANT_EXPRESSION: {
+    int64_t value = ast_constant_value(node);
+    unsigned long long magnitude =
+        value < 0 ? 0 - (unsigned long long)value : (unsigned long long)value;
+    return convert_integer_constant(codegen, value < 0, magnitude,
+                                    expected_type,
+                                    ast_token_line(ast, node->main_token));
+  }
+
+  case AST_BOOL_LITERAL_EXPRESSION:
+    return (TypedValue){
+        .value = LLVMConstInt(llvm_type_of(codegen, TOKEN_BOOL), node->lhs,
+                              false),
+        .type = TOKEN_BOOL};
+
+  case AST_UNARY_EXPRESSION:
+    return convert_unary(codegen, node, expected_type);
+
+  case AST_BINARY_EXPRESSION:
+    return convert_binary(codegen, node, expected_type);
+
+  case AST_STRING_LITERAL_EXPRESSION:
+    return (TypedValue){
+        .value = get_string_literal(codegen,
+                                    ast->tokens.intern_ids[node->main_token]),
+        .type = TOKEN_STRING};
+
+  case AST_IDENTIFIER_EXPRESSION: {
+    Token name = ast_token(ast, node->main_token);
+    const SymbolEntry *local = find_local(codegen, name);
+    if (!local) {
+      fprintf(stderr, "Error: Unknown variable '%.*s' (line %zu)\n",
+              (int)name.length, name.start_ptr, name.line);
+      exit(1);
+    }
+
+    const char *value_name = intern_get(name.intern_id)->data;
+    return (TypedValue){
+        .value = LLVMBuildLoad2(codegen->builder,
+                                llvm_type_of(codegen, local->type),
+                                local->value, value_name),
+        .type = local->type};
+  }
+
+  case AST_CAST_EXPRESSION: {
+    // A literal operand takes the target type directly.
+    TokenKind type = (TokenKind)ast->tokens.kinds[node->main_token];
+    TypedValue operand = convert_expression(codegen, node->lhs, type);
+    if (!is_integer_type(operand.type) && operand.type != TOKEN_BOOL) {
+      fprintf(stderr, "Error: Cannot convert %s to %s (line %zu)\n",
+              type_name(operand.type), type_name(type),
+              ast_token_line(ast, node->main_token));
+      exit(1);
+    }
+    return (TypedValue){.value = resize_integer(codegen, operand, type),
+                        .type = type};
+  }
+
+  case AST_CALL_EXPRESSION:
+    return convert_call(codegen, index);
+
+  case AST_INDEX_EXPRESSION:
+    return convert_index(codegen, node);
 
-// Helper function to add function to symbol table
-void add_function_to_symbol_table(const char *name, LLVMValueRef function) {
-  if (symbol_table.count >= symbol_table.capacity) {
-    symbol_table.capacity =
-        symbol_table.capacity == 0 ? 8 : symbol_table.capacity * 2;
-    symbol_table.functions = realloc(
-        symbol_table.functions, symbol_table.capacity * sizeof(FunctionEntry));
+  case AST_SLICE_EXPRESSION:
+    return convert_slice(codegen, node);
+
+  case AST_VECTOR_EXPRESSION:
+    return convert_vector(codegen, node);
+
+  default:
+    fprintf(stderr, "Error: Unhandled AST expression kind: %d\n", node->kind);
+    exit(1);
+  }
+}
+
+// Helper function to create the stack slot of a local variable. Slots are
+// placed at the start of the entry block, where mem2reg and SROA promote
+// them to registers.
+LLVMValueRef create_local_slot(Codegen *codegen, TokenKind type,
+                               const char *name) {
+  LLVMBasicBlockRef entry = LLVMGetEntryBasicBlock(
+      LLVMGetBasicBlockParent(LLVMGetInsertBlock(codegen->builder)));
+  LLVMValueRef first = LLVMGetFirstInstruction(entry);
+
+  LLVMBuilderRef builder = LLVMCreateBuilderInContext(codegen->llvm_context);
+  if (first) {
+    LLVMPositionBuilderBefore(builder, first);
+  } else {
+    LLVMPositionBuilderAtEnd(builder, entry);
   }
+  LLVMValueRef slot =
+      LLVMBuildAlloca(builder, llvm_type_of(codegen, type), name);
+  LLVMDisposeBuilder(builder);
+  return slot;
+}
 
-  symbol_table.functions[symbol_table.count].name = strdup(name);
-  symbol_table.functions[symbol_table.count].function = function;
-  symbol_table.count++;
+// Helper function to check whether the block being filled already ends in
+// a branch or return.
+bool is_block_terminated(Codegen *codegen) {
+  return LLVMGetBasicBlockTerminator(LLVMGetInsertBlock(codegen->builder)) !=
+         NULL;
 }
 
-// Helper function to find function in symbol table
-LLVMValueRef find_function_in_symbol_table(const char *name) {
-  for (size_t i = 0; i < symbol_table.count; i++) {
-    if (strcmp(symbol_table.functions[i].name, name) == 0) {
-      return symbol_table.functions[i].function;
-    }
+// Helper function to add a block created by LLVMCreateBasicBlockInContext
+// to the end of the function and continue filling it. Blocks are added
+// once they are reached, so they appear in source order.
+void begin_block(Codegen *codegen, LLVMBasicBlockRef block) {
+  LLVMValueRef function =
+      LLVMGetBasicBlockParent(LLVMGetInsertBlock(codegen->builder));
+  LLVMAppendExistingBasicBlock(function, block);
+  LLVMPositionBuilderAtEnd(codegen->builder, block);
+}
+
+// Helper function to check whether any branch leads to the block being
+// filled. Code is never placed after a return or break, so a block which
+// is not the entry block is reachable exactly when it is branched to.
+bool is_block_reachable(Codegen *codegen) {
+  LLVMBasicBlockRef block = LLVMGetInsertBlock(codegen->builder);
+  return block == LLVMGetEntryBasicBlock(LLVMGetBasicBlockParent(block)) ||
+         LLVMGetFirstUse(LLVMBasicBlockAsValue(block)) != NULL;
+}
+
+// Helper function to branch to a block unless the current block already
+// left, e.g. through a return. A block no branch leads to, such as the end
+// of an if whose branches all return, must not make the target reachable.
+void branch_to(Codegen *codegen, LLVMBasicBlockRef block) {
+  if (is_block_terminated(codegen)) {
+    return;
+  }
+
+  if (is_block_reachable(codegen)) {
+    LLVMBuildBr(codegen->builder, block);
+  } else {
+    LLVMBuildUnreachable(codegen->builder);
   }
-  return NULL;
 }
 
-// Helper function to substring a string.
-char *substring(const char *base, size_t length) {
-  char *result = malloc(length + 1);
-  if (!result) {
-    fprintf(stderr, "Memory allocation failed\n");
-    exit(1);
+// Helper function to lower the condition of an if statement or loop.
+LLVMValueRef convert_condition(Codegen *codegen, AstIndex index) {
+  const Ast *ast = codegen->ast;
+  size_t line = ast_token_line(ast, ast_node(ast, index)->main_token);
+  TypedValue condition = convert_expression(codegen, index, TOKEN_BOOL);
+  return convert_to_type(codegen, condition, TOKEN_BOOL, line);
+}
+
+// Helper function to check whether a loop condition is the constant true,
+// so the loop only ends through break or return.
+bool is_always_true(const Ast *ast, AstIndex index) {
+  const AstNode *node = ast_node(ast, index);
+  return node->kind == AST_BOOL_LITERAL_EXPRESSION && node->lhs;
+}
+
+// Helper function to lower the condition of a loop, branching to the body
+// or the end of the loop.
+void convert_loop_condition(Codegen *codegen, AstIndex index,
+                            LLVMBasicBlockRef body_block,
+                            LLVMBasicBlockRef end_block) {
+  if (index == AST_NONE || is_always_true(codegen->ast, index)) {
+    LLVMBuildBr(codegen->builder, body_block);
+  } else {
+    LLVMBuildCondBr(codegen->builder, convert_condition(codegen, index),
+                    body_block, end_block);
   }
-  strncpy(result, base, length);
-  result[length] = '\0';
-  return result;
 }
 
-// Helper function to convert primitive type to LLVM type.
-LLVMTypeRef
-get_llvm_equivalent_for_primitive_type(Token primitive_type_token,
-                                       LLVMContextRef llvm_context) {
-  switch (primitive_type_token.kind) {
-  case TOKEN_VOID:
-    return LLVMVoidTypeInContext(llvm_context);
-  case TOKEN_INT:
-    return LLVMInt8TypeInContext(llvm_context);
-    break;
+void convert_statement(Codegen *codegen, AstIndex index);
 
-  case TOKEN_STRING: {
-    LLVMTypeRef i8_ptr =
-        LLVMPointerType(LLVMInt8TypeInContext(llvm_context), 0);
-    LLVMTypeRef len_type = LLVMInt8TypeInContext(llvm_context);
-    LLVMTypeRef members[] = {i8_ptr, len_type};
-    return LLVMStructTypeInContext(llvm_context, members, 2, false);
-  } break;
+// Helper function to convert the statements of a block, whose variables go
+// out of scope at its end.
+void convert_block(Codegen *codegen, AstIndex index) {
+  const Ast *ast = codegen->ast;
+  const AstNode *block = ast_node(ast, index);
+  size_t scope_top = codegen->scope_names.length;
+  for (uint32_t i = block->lhs; i < block->rhs; i++) {
+    AstIndex statement = ast->extra.data[i];
+    if (is_block_terminated(codegen) || !is_block_reachable(codegen)) {
+      fprintf(stderr, "Error: Unreachable code (line %zu)\n",
+              ast_token_line(ast, ast_node(ast, statement)->main_token));
+      exit(1);
+    }
+    convert_statement(codegen, statement);
+  }
+  end_scope(codegen, scope_top);
+}
 
-  default:
-    fprintf(stderr, "Error: %s is not a primitive type.",
-            token_kind_to_string(primitive_type_token.kind));
+// Helper function to convert a `let` binding.
+void convert_let(Codegen *codegen, const AstNode *node) {
+  const Ast *ast = codegen->ast;
+  Token name = ast_token(ast, node->main_token);
+
+  // Without a type the variable takes the type of its value.
+  TokenKind type = node->rhs ? (TokenKind)ast->tokens.kinds[node->rhs]
+                             : TOKEN_EOF;
+  TypedValue value = convert_expression(codegen, node->lhs, type);
+  if (type == TOKEN_EOF) {
+    type = value.type;
+  }
+  if (type == TOKEN_VOID) {
+    fprintf(stderr, "Error: '%.*s' cannot hold a void value (line %zu)\n",
+            (int)name.length, name.start_ptr, name.line);
     exit(1);
   }
+
+  LLVMValueRef converted = convert_to_type(codegen, value, type, name.line);
+  LLVMValueRef slot =
+      create_local_slot(codegen, type, intern_get(name.intern_id)->data);
+  LLVMBuildStore(codegen->builder, converted, slot);
+  add_local(codegen, name, slot, type);
 }
 
-char *process_escape_sequences(const char *raw_string, size_t length) {
-  char *processed = malloc(length + 1); // Allocate maximum possible size
-  if (!processed) {
-    fprintf(stderr, "Memory allocation failed\n");
+// Helper function to convert an assignment to a variable.
+void convert_assignment(Codegen *codegen, const AstNode *node) {
+  const Ast *ast = codegen->ast;
+  const AstNode *target = ast_node(ast, node->lhs);
+  size_t line = ast_token_line(ast, node->main_token);
+  if (target->kind != AST_IDENTIFIER_EXPRESSION) {
+    fprintf(stderr, "Error: Only variables can be assigned to (line %zu)\n",
+            line);
     exit(1);
   }
 
-  size_t write_pos = 0;
-  for (size_t read_pos = 0; read_pos < length; read_pos++) {
-    if (raw_string[read_pos] == '\\' && read_pos + 1 < length) {
-      // Process escape sequence
-      switch (raw_string[read_pos + 1]) {
-      case 'n':
-        processed[write_pos++] = '\n';
-        break;
-      case 't':
-        processed[write_pos++] = '\t';
-        break;
-      case 'r':
-        processed[write_pos++] = '\r';
-        break;
-      case '\\':
-        processed[write_pos++] = '\\';
-        break;
-      case '"':
-        processed[write_pos++] = '"';
-        break;
-      case '0':
-        processed[write_pos++] = '\0';
-        break;
-      default:
-        // If it's not a recognized escape sequence, keep both characters
-        processed[write_pos++] = raw_string[read_pos];
-        processed[write_pos++] = raw_string[read_pos + 1];
-        break;
-      }
-      read_pos++; // Skip the escaped character
-    } else {
-      processed[write_pos++] = raw_string[read_pos];
-    }
+  Token name = ast_token(ast, target->main_token);
+  const SymbolEntry *local = find_local(codegen, name);
+  if (!local) {
+    fprintf(stderr, "Error: Unknown variable '%.*s' (line %zu)\n",
+            (int)name.length, name.start_ptr, name.line);
+    exit(1);
   }
 
-  processed[write_pos] = '\0';
-  return processed;
+  TypedValue value = convert_expression(codegen, node->rhs, local->type);
+  LLVMBuildStore(codegen->builder,
+                 convert_to_type(codegen, value, local->type, line),
+                 local->value);
 }
 
-LLVMValueRef convert_statement(AstNode *node, LLVMModuleRef llvm_module,
-                               LLVMContextRef llvm_context,
-                               LLVMBuilderRef builder) {
-  switch (node->kind) {
-  case AST_INT_LITERAL_EXPRESSION: {
-    char *value_str = substring(node->as.literal.token.start_ptr,
-                                node->as.literal.token.length);
-    int value = atoi(value_str);
-    free(value_str);
+// Helper function to convert an if statement and its else branches.
+void convert_if(Codegen *codegen, const AstNode *node) {
+  const Ast *ast = codegen->ast;
+  AstIndex then_branch = ast->extra.data[node->rhs];
+  AstIndex else_branch = ast->extra.data[node->rhs + 1];
 
-    LLVMTypeRef i8 = LLVMInt8TypeInContext(llvm_context);
-    return LLVMConstInt(i8, value, 0);
-  } break;
+  LLVMContextRef llvm_context = codegen->llvm_context;
+  LLVMBasicBlockRef then_block =
+      LLVMCreateBasicBlockInContext(llvm_context, "if.then");
+  LLVMBasicBlockRef else_block =
+      else_branch != AST_NONE
+          ? LLVMCreateBasicBlockInContext(llvm_context, "if.else")
+          : NULL;
+  LLVMBasicBlockRef end_block =
+      LLVMCreateBasicBlockInContext(llvm_context, "if.end");
 
-  case AST_STRING_LITERAL_EXPRESSION: {
-    // Strip quotes
-    char *raw = substring(node->as.string_literal.token.start_ptr + 1,
-                          node->as.string_literal.token.length - 2);
+  LLVMValueRef condition = convert_condition(codegen, node->lhs);
+  LLVMBuildCondBr(codegen->builder, condition, then_block,
+                  else_block ? else_block : end_block);
 
-    // Process escape sequences
-    char *processed = process_escape_sequences(raw, strlen(raw));
-    size_t len = strlen(processed);
+  begin_block(codegen, then_block);
+  convert_statement(codegen, then_branch);
+  branch_to(codegen, end_block);
 
-    // Create a global constant string
-    LLVMValueRef str_ptr = LLVMBuildGlobalStringPtr(builder, processed, "str");
-    free(raw);
-    free(processed);
+  if (else_block) {
+    begin_block(codegen, else_block);
+    convert_statement(codegen, else_branch);
+    branch_to(codegen, end_block);
+  }
 
-    LLVMTypeRef i8_ptr =
-        LLVMPointerType(LLVMInt8TypeInContext(llvm_context), 0);
-    LLVMTypeRef len_type = LLVMInt8TypeInContext(llvm_context);
-    LLVMTypeRef members[] = {i8_ptr, len_type};
-    LLVMTypeRef string_type =
-        LLVMStructTypeInContext(llvm_context, members, 2, false);
+  // When every branch returns, the end block is never reached, and only
+  // code which is never run follows.
+  begin_block(codegen, end_block);
+}
 
-    LLVMValueRef tmp = LLVMGetUndef(string_type);
-    tmp = LLVMBuildInsertValue(builder, tmp, str_ptr, 0, "str_data");
-    tmp = LLVMBuildInsertValue(builder, tmp, LLVMConstInt(len_type, len, 0), 1,
-                               "str_len");
+// Helper function to convert the body of a loop, with `break` and
+// `continue` leading to the given blocks.
+void convert_loop_body(Codegen *codegen, AstIndex body,
+                       LLVMBasicBlockRef break_block,
+                       LLVMBasicBlockRef continue_block) {
+  LLVMBasicBlockRef outer_break_block = codegen->break_block;
+  LLVMBasicBlockRef outer_continue_block = codegen->continue_block;
+  codegen->break_block = break_block;
+  codegen->continue_block = continue_block;
 
-    return tmp;
-  } break;
+  convert_block(codegen, body);
+  branch_to(codegen, continue_block);
 
-  case AST_CALL_EXPRESSION: {
-    char *fn_name = substring(node->as.call_expression.callee->token.start_ptr,
-                              node->as.call_expression.callee->token.length);
+  codegen->break_block = outer_break_block;
+  codegen->continue_block = outer_continue_block;
+}
 
-    LLVMValueRef function = find_function_in_symbol_table(fn_name);
-    if (!function) {
-      fprintf(stderr, "Error: Function '%s' not found\n", fn_name);
-      free(fn_name);
-      exit(1);
-    }
+// Helper function to convert a while loop.
+void convert_while(Codegen *codegen, const AstNode *node) {
+  LLVMContextRef llvm_context = codegen->llvm_context;
+  LLVMBasicBlockRef condition_block =
+      LLVMCreateBasicBlockInContext(llvm_context, "while.cond");
+  LLVMBasicBlockRef body_block =
+      LLVMCreateBasicBlockInContext(llvm_context, "while.body");
+  LLVMBasicBlockRef end_block =
+      LLVMCreateBasicBlockInContext(llvm_context, "while.end");
 
-    LLVMValueRef *args = NULL;
-    if (node->as.call_expression.arguments.length > 0) {
-      args = malloc(node->as.call_expression.arguments.length *
-                    sizeof(LLVMValueRef));
+  LLVMBuildBr(codegen->builder, condition_block);
+  begin_block(codegen, condition_block);
+  convert_loop_condition(codegen, node->lhs, body_block, end_block);
 
-      for (size_t i = 0; i < node->as.call_expression.arguments.length; i++) {
-        LLVMValueRef value =
-            convert_statement(node->as.call_expression.arguments.data[i],
-                              llvm_module, llvm_context, builder);
+  begin_block(codegen, body_block);
+  convert_loop_body(codegen, node->rhs, end_block, condition_block);
 
-        if (LLVMGetTypeKind(LLVMTypeOf(value)) == LLVMStructTypeKind) {
-          value = LLVMBuildExtractValue(builder, value, 0, "str_data");
-        }
-        args[i] = value;
-      }
-    }
+  begin_block(codegen, end_block);
+}
 
-    LLVMValueRef call_result =
-        LLVMBuildCall2(builder, LLVMGlobalGetValueType(function), function,
-                       args, node->as.call_expression.arguments.length, "");
+// Helper function to convert a for loop. Variables declared by its first
+// clause are only visible inside the loop.
+void convert_for(Codegen *codegen, const AstNode *node) {
+  const Ast *ast = codegen->ast;
+  AstIndex init = ast->extra.data[node->lhs];
+  AstIndex condition = ast->extra.data[node->lhs + 1];
+  AstIndex step = ast->extra.data[node->lhs + 2];
 
-    if (args)
-      free(args);
-    free(fn_name);
+  size_t scope_top = codegen->scope_names.length;
+  if (init != AST_NONE) {
+    convert_statement(codegen, init);
+  }
 
-    LLVMTypeRef fn_type = LLVMGlobalGetValueType(function);
-    LLVMTypeRef return_type = LLVMGetReturnType(fn_type);
+  LLVMContextRef llvm_context = codegen->llvm_context;
+  LLVMBasicBlockRef condition_block =
+      LLVMCreateBasicBlockInContext(llvm_context, "for.cond");
+  LLVMBasicBlockRef body_block =
+      LLVMCreateBasicBlockInContext(llvm_context, "for.body");
+  LLVMBasicBlockRef step_block =
+      LLVMCreateBasicBlockInContext(llvm_context, "for.step");
+  LLVMBasicBlockRef end_block =
+      LLVMCreateBasicBlockInContext(llvm_context, "for.end");
 
-    return call_result;
-  } break;
+  // A loop without a condition only ends through break or return.
+  LLVMBuildBr(codegen->builder, condition_block);
+  begin_block(codegen, condition_block);
+  convert_loop_condition(codegen, condition, body_block, end_block);
+
+  begin_block(codegen, body_block);
+  convert_loop_body(codegen, node->rhs, end_block, step_block);
+
+  begin_block(codegen, step_block);
+  if (step != AST_NONE) {
+    convert_statement(codegen, step);
+  }
+  branch_to(codegen, condition_block);
+
+  begin_block(codegen, end_block);
+  end_scope(codegen, scope_top);
+}
+
+// Helper function to convert a statement to IR.
+void convert_statement(Codegen *codegen, AstIndex index) {
+  LLVMBuilderRef builder = codegen->builder;
+  const Ast *ast = codegen->ast;
+  const AstNode *node = ast_node(ast, index);
+  size_t line = ast_token_line(ast, node->main_token);
 
+  switch (node->kind) {
   case AST_RETURN_STATEMENT: {
-    if (node->as.return_statement.value) {
-      LLVMValueRef return_value = convert_statement(
-          node->as.return_statement.value, llvm_module, llvm_context, builder);
-      LLVMBuildRet(builder, return_value);
-    } else {
+    if (node->lhs != AST_NONE && codegen->return_type != TOKEN_VOID) {
+      TypedValue value =
+          convert_expression(codegen, node->lhs, codegen->return_type);
+      LLVMBuildRet(builder, convert_to_type(codegen, value,
+                                            codegen->return_type, line));
+    } else if (node->lhs == AST_NONE && codegen->return_type == TOKEN_VOID) {
       // For void functions
       LLVMBuildRetVoid(builder);
+    } else {
+      fprintf(stderr, "Error: Function must return a value of type %s "
+                      "(line %zu)\n",
+              type_name(codegen->return_type), line);
+      exit(1);
+    }
+  } break;
+
+  case AST_BLOCK_STATEMENT:
+    convert_block(codegen, index);
+    break;
+
+  case AST_LET_STATEMENT:
+    convert_let(codegen, node);
+    break;
+
+  case AST_ASSIGN_STATEMENT:
+    convert_assignment(codegen, node);
+    break;
+
+  case AST_IF_STATEMENT:
+    convert_if(codegen, node);
+    break;
+
+  case AST_WHILE_STATEMENT:
+    convert_while(codegen, node);
+    break;
+
+  case AST_FOR_STATEMENT:
+    convert_for(codegen, node);
+    break;
+
+  case AST_BREAK_STATEMENT:
+  case AST_CONTINUE_STATEMENT: {
+    bool is_break = node->kind == AST_BREAK_STATEMENT;
+    LLVMBasicBlockRef target =
+        is_break ? codegen->break_block : codegen->continue_block;
+    if (!target) {
+      fprintf(stderr, "Error: '%s' outside of a loop (line %zu)\n",
+              is_break ? "break" : "continue", line);
+      exit(1);
     }
+    LLVMBuildBr(builder, target);
   } break;
+
   default:
-    fprintf(stderr, "Error: Unhandled AST statement kind: %d\n", node->kind);
-    exit(1);
+    // An expression evaluated for its side effects.
+    convert_expression(codegen, index, TOKEN_EOF);
+    break;
   }
-
-  return NULL;
 }
 
 // Helper function to create LLVM function signature from parameters
@@ -242,26 +2002,32 @@ typedef struct {
   bool has_tail_arg;
 } FunctionSignature;
 
-FunctionSignature create_function_signature(Token return_type,
-                                            AstNodeVector parameters,
+FunctionSignature create_function_signature(const Ast *ast,
+                                            TokenIndex return_type,
+                                            uint32_t params_start,
+                                            uint32_t params_end,
                                             LLVMContextRef llvm_context,
                                             bool is_foreign) {
   // Build return type
   LLVMTypeRef llvm_return_type =
-      get_llvm_equivalent_for_primitive_type(return_type, llvm_context);
+      get_llvm_equivalent_for_primitive_type(ast_token(ast, return_type),
+                                             llvm_context);
 
-  // Setup parameter types
+  // Setup parameter types, a @sized String takes two.
   LLVMTypeRef *param_types = NULL;
   bool has_tail_arg = false;
-  unsigned param_count = parameters.length;
+  unsigned param_count = params_end - params_start;
+  unsigned llvm_param_count = 0;
 
   if (param_count > 0) {
-    param_types = malloc(param_count * sizeof(LLVMTypeRef));
+    param_types = malloc(2 * param_count * sizeof(LLVMTypeRef));
     for (unsigned i = 0; i < param_count; i++) {
-      AstNode *param = parameters.data[i];
+      const AstNode *param =
+          ast_node(ast, ast->extra.data[params_start + i]);
+      Token parameter_type = ast_token(ast, param->main_token);
 
       // Check tail parameter constraint (only for non-foreign functions)
-      if (param->as.parameter.is_tail_parameter) {
+      if (param->lhs) {
         if (i != param_count - 1) {
           fprintf(
               stderr,
@@ -274,108 +2040,238 @@ FunctionSignature create_function_signature(Token return_type,
         has_tail_arg = true;
       }
 
+      if (param->rhs && !is_foreign) {
+        fprintf(stderr, "Error: %s only applies to parameters of foreign "
+                        "functions.\n",
+                param->rhs & AST_PARAMETER_SIZED ? "@sized" : "@noalias");
+        exit(1);
+      }
+
       // Special handling for foreign functions with string parameters
-      if (is_foreign &&
-          param->as.parameter.parameter_type.kind == TOKEN_STRING) {
-        param_types[i] =
+      if (is_foreign && parameter_type.kind == TOKEN_STRING) {
+        param_types[llvm_param_count++] =
             LLVMPointerType(LLVMInt8TypeInContext(llvm_context), 0);
+        if (param->rhs & AST_PARAMETER_SIZED) {
+          param_types[llvm_param_count++] =
+              LLVMInt64TypeInContext(llvm_context);
+        }
       } else {
-        param_types[i] = get_llvm_equivalent_for_primitive_type(
-            param->as.parameter.parameter_type, llvm_context);
+        param_types[llvm_param_count++] =
+            get_llvm_equivalent_for_primitive_type(parameter_type,
+                                                   llvm_context);
       }
     }
   }
 
   // Create function type
-  LLVMTypeRef function_type = LLVMFunctionType(llvm_return_type, param_types,
-                                               param_count, has_tail_arg);
+  LLVMTypeRef function_type = LLVMFunctionType(
+      llvm_return_type, param_types, llvm_param_count, has_tail_arg);
 
   FunctionSignature signature = {.function_type = function_type,
                                  .param_types = param_types,
-                                 .param_count = param_count,
+                                 .param_count = llvm_param_count,
                                  .has_tail_arg = has_tail_arg};
 
   return signature;
 }
 
-// Helper function to convert a node to IR.
-void convert_declaration(AstNode *node, LLVMModuleRef llvm_module,
-                         LLVMContextRef llvm_context, LLVMBuilderRef builder) {
+// Helper function to attach the annotations written before a declaration,
+// and the @noalias of its parameters, to the function as LLVM attributes.
+// They are promises the optimizer relies on and are not checked.
+void add_function_annotations(Codegen *codegen, LLVMValueRef fn,
+                              const AstNode *node) {
+  const Ast *ast = codegen->ast;
+  uint32_t params_start, params_end;
+  ast_declaration_parameters(ast, node, &params_start, &params_end);
+
+  // A pure function may still read the characters of its Strings.
+  bool reads_memory = false;
+  for (uint32_t i = params_start; i < params_end; i++) {
+    const AstNode *param = ast_node(ast, ast->extra.data[i]);
+    reads_memory |= ast->tokens.kinds[param->main_token] == TOKEN_STRING;
+  }
+
+  TokenIndex annotations_start, annotations_end;
+  ast_declaration_annotations(ast, node, &annotations_start, &annotations_end);
+  for (TokenIndex i = annotations_start; i < annotations_end; i++) {
+    const char *names[3] = {NULL, NULL, NULL};
+    switch ((TokenKind)ast->tokens.kinds[i]) {
+    case TOKEN_INLINE:
+      names[0] = "alwaysinline";
+      break;
+    case TOKEN_NOINLINE:
+      names[0] = "noinline";
+      break;
+    case TOKEN_COLD:
+      names[0] = "cold";
+      break;
+    case TOKEN_NOUNWIND:
+      names[0] = "nounwind";
+      break;
+    default: // TOKEN_PURE
+      // Calls with the same arguments may be merged, hoisted or removed.
+      names[0] = reads_memory ? "readonly" : "readnone";
+      names[1] = "nounwind";
+      names[2] = "willreturn";
+      break;
+    }
+
+    for (size_t j = 0; j < 3 && names[j]; j++) {
+      LLVMAddAttributeAtIndex(fn, LLVMAttributeFunctionIndex,
+                              create_enum_attribute(codegen, names[j]));
+    }
+  }
+
+  unsigned llvm_index = 1;
+  for (uint32_t i = params_start; i < params_end; i++) {
+    const AstNode *param = ast_node(ast, ast->extra.data[i]);
+    if (param->rhs & AST_PARAMETER_NOALIAS) {
+      LLVMAddAttributeAtIndex(fn, llvm_index,
+                              create_enum_attribute(codegen, "noalias"));
+    }
+    llvm_index += param->rhs & AST_PARAMETER_SIZED ? 2 : 1;
+  }
+}
+
+// Helper function to add the LLVM function for a declaration.
+// All declarations are added before any body is converted, so functions
+// may be called before (or in another file than) their definition.
+void declare_function(Codegen *codegen, AstIndex index) {
+  LLVMModuleRef llvm_module = codegen->llvm_module;
+  LLVMContextRef llvm_context = codegen->llvm_context;
+  const Ast *ast = codegen->ast;
+  const AstNode *node = ast_node(ast, index);
+
   switch (node->kind) {
   case AST_FOREIGN_DECLARATION: {
-    FunctionSignature signature = create_function_signature(
-        node->as.foreign_declaration.return_type,
-        node->as.foreign_declaration.parameters, llvm_context, true);
+    FunctionSignature signature =
+        create_function_signature(ast, node->main_token, node->lhs, node->rhs,
+                                  llvm_context, true);
 
-    char *source_name =
-        substring(node->as.foreign_declaration.symbol_name.start_ptr + 1,
-                  node->as.foreign_declaration.symbol_name.length - 2);
-    char *ferro_fn_name =
-        substring(node->as.foreign_declaration.fn_name.start_ptr,
-                  node->as.foreign_declaration.fn_name.length);
+    // The symbol name is the second string between the parentheses of
+    // @foreign, two tokens before the return type.
+    const char *source_name =
+        intern_get(ast->tokens.intern_ids[node->main_token - 2])->data;
 
     LLVMValueRef fn =
         LLVMAddFunction(llvm_module, source_name, signature.function_type);
-    add_function_to_symbol_table(ferro_fn_name, fn);
+    add_function_to_symbol_table(&codegen->symbol_table,
+                                 ast_token(ast, node->main_token + 1), fn);
+    add_function_annotations(codegen, fn, node);
+
+    // C expects narrow integers to be extended by the caller.
+    add_extension_attribute(codegen, fn, LLVMAttributeReturnIndex,
+                            (TokenKind)ast->tokens.kinds[node->main_token],
+                            false);
+    unsigned llvm_index = 1;
+    for (uint32_t i = node->lhs; i < node->rhs; i++) {
+      const AstNode *param = ast_node(ast, ast->extra.data[i]);
+      add_extension_attribute(
+          codegen, fn, llvm_index,
+          (TokenKind)ast->tokens.kinds[param->main_token], false);
+      llvm_index += param->rhs & AST_PARAMETER_SIZED ? 2 : 1;
+    }
 
     // Cleanup
     if (signature.param_types)
       free(signature.param_types);
-    free(source_name);
-    free(ferro_fn_name);
   } break;
 
   case AST_FUNCTION_DECLARATION: {
     FunctionSignature signature = create_function_signature(
-        node->as.function_declaration.return_type,
-        node->as.function_declaration.parameters, llvm_context, false);
+        ast, node->main_token, ast->extra.data[node->lhs],
+        ast->extra.data[node->lhs + 1], llvm_context, false);
 
-    char *fn_name = substring(node->as.function_declaration.fn_name.start_ptr,
-                              node->as.function_declaration.fn_name.length);
-    LLVMValueRef fn =
-        LLVMAddFunction(llvm_module, fn_name, signature.function_type);
-    add_function_to_symbol_table(fn_name, fn);
+    Token fn_name = ast_token(ast, node->main_token + 1);
+    LLVMValueRef fn = LLVMAddFunction(
+        llvm_module, intern_get(fn_name.intern_id)->data,
+        signature.function_type);
+    add_function_to_symbol_table(&codegen->symbol_table, fn_name, fn);
+    add_function_annotations(codegen, fn, node);
+
+    // Cleanup
+    if (signature.param_types)
+      free(signature.param_types);
+  } break;
+  default:
+    fprintf(stderr, "Error: Unsupported AST declaration kind: %d\n",
+            node->kind);
+    exit(1);
+  }
+}
+
+// Helper function to convert a node to IR.
+void convert_declaration(Codegen *codegen, AstIndex index) {
+  LLVMContextRef llvm_context = codegen->llvm_context;
+  LLVMBuilderRef builder = codegen->builder;
+  const Ast *ast = codegen->ast;
+  const AstNode *node = ast_node(ast, index);
+
+  switch (node->kind) {
+  case AST_FOREIGN_DECLARATION:
+    // Nothing to convert, the symbol is provided by C.
+    break;
+
+  case AST_FUNCTION_DECLARATION: {
+    LLVMValueRef fn = find_function_in_symbol_table(
+        &codegen->symbol_table, ast_token(ast, node->main_token + 1));
+    LLVMTypeRef function_type = LLVMGlobalGetValueType(fn);
 
     // Create function body
     LLVMBasicBlockRef fn_main =
         LLVMAppendBasicBlockInContext(llvm_context, fn, "entry");
     LLVMPositionBuilderAtEnd(builder, fn_main);
 
-    // Convert statements to IR
-    bool has_return = false;
-    AstNode *block_node = node->as.function_declaration.block;
-    for (int i = 0; i < (int)block_node->as.block_statement.statements.length;
-         i++) {
-      AstNode *stmt = block_node->as.block_statement.statements.data[i];
-
-      if (stmt->kind == AST_RETURN_STATEMENT) {
-        has_return = true;
-        convert_statement(stmt, llvm_module, llvm_context, builder);
-        break;
-      } else {
-        convert_statement(stmt, llvm_module, llvm_context, builder);
+    // Giving every parameter a stack slot, so it may be assigned to like
+    // any variable. The values of a tail parameter are only reachable
+    // from C.
+    codegen->return_type = (TokenKind)ast->tokens.kinds[node->main_token];
+    free_symbol_table(&codegen->locals);
+    uint32_t params_start = ast->extra.data[node->lhs];
+    uint32_t params_end = ast->extra.data[node->lhs + 1];
+    for (uint32_t i = params_start; i < params_end; i++) {
+      const AstNode *param = ast_node(ast, ast->extra.data[i]);
+      if (param->lhs) {
+        continue;
       }
+
+      Token name = ast_token(ast, param->main_token + 1);
+      TokenKind type = (TokenKind)ast->tokens.kinds[param->main_token];
+      const char *param_name = intern_get(name.intern_id)->data;
+      LLVMValueRef value = LLVMGetParam(fn, i - params_start);
+      LLVMSetValueName2(value, name.start_ptr, name.length);
+
+      char slot_name[64];
+      snprintf(slot_name, sizeof(slot_name), "%s.addr", param_name);
+      LLVMValueRef slot = create_local_slot(codegen, type, slot_name);
+      LLVMBuildStore(builder, value, slot);
+      add_local(codegen, name, slot, type);
     }
 
-    // Add default return if none found
-    if (!has_return) {
-      LLVMTypeRef return_type = LLVMGetReturnType(signature.function_type);
-      if (LLVMGetTypeKind(return_type) == LLVMVoidTypeKind) {
+    // Convert statements to IR
+    convert_block(codegen, node->rhs);
+
+    // Falling off the end returns from a void function. The last block
+    // may also be one no branch leads to, e.g. after an if whose branches
+    // all return.
+    if (!is_block_terminated(codegen)) {
+      if (!is_block_reachable(codegen)) {
+        LLVMBuildUnreachable(builder);
+      } else if (LLVMGetTypeKind(LLVMGetReturnType(function_type)) ==
+                 LLVMVoidTypeKind) {
         LLVMBuildRetVoid(builder);
       } else {
         // A non-void function must return a value. Emit an error and exit.
-        fprintf(stderr, "Error: Function must return a value of type ");
-        char *type_str = LLVMPrintTypeToString(return_type);
-        fprintf(stderr, "%s\n", type_str);
-        LLVMDisposeMessage(type_str); // Free the type string memory
+        Token fn_name = ast_token(ast, node->main_token + 1);
+        fprintf(stderr,
+                "Error: Function '%.*s' must return a value of type %s\n",
+                (int)fn_name.length, fn_name.start_ptr,
+                type_name(codegen->return_type));
         exit(EXIT_FAILURE);
       }
     }
-
-    // Cleanup
-    if (signature.param_types)
-      free(signature.param_types);
-    free(fn_name);
+    vec_free(InternId, &codegen->scope_names);
+    free_symbol_table(&codegen->locals);
   } break;
   default:
     fprintf(stderr, "Error: Unsupported AST declaration kind: %d\n",
@@ -384,62 +2280,342 @@ void convert_declaration(AstNode *node, LLVMModuleRef llvm_module,
   }
 }
 
-// Function to generate LLVM IR.
-const char *codegen(AstNode *translation_unit) {
-  if (translation_unit->kind != AST_TRANSLATION_UNIT) {
-    printf("Provided node is not a translation unit.\n");
-    exit(1);
+// Function to lower the syntax trees of several files into a single LLVM
+// module.
+LLVMModuleRef codegen(const Ast *asts, size_t unit_count,
+                      LLVMContextRef llvm_context, CodegenStats *stats) {
+  for (size_t i = 0; i < unit_count; i++) {
+    if (asts[i].nodes.length == 0 ||
+        ast_node(&asts[i], 0)->kind != AST_TRANSLATION_UNIT) {
+      printf("Provided node is not a translation unit.\n");
+      exit(1);
+    }
   }
 
-  // Creating LLVM context and module.
-  LLVMContextRef llvm_context = LLVMContextCreate();
-  LLVMModuleRef llvm_module =
+  // Creating LLVM module and IR builder.
+  Codegen codegen = {0};
+  codegen.llvm_context = llvm_context;
+  codegen.llvm_module =
       LLVMModuleCreateWithNameInContext("main_module", llvm_context);
+  codegen.builder = LLVMCreateBuilderInContext(llvm_context);
+  codegen.stats = stats;
+  codegen.asts = asts;
+
+  // Calls are typed by the declarations of every file.
+  DeclarationTable declarations = {0};
+  build_declaration_table(&declarations, asts, unit_count);
+  codegen.declarations = &declarations;
+
+  // Declaring every function first, then converting the bodies.
+  for (size_t i = 0; i < unit_count; i++) {
+    codegen.ast = &asts[i];
+    const AstNode *unit = ast_node(codegen.ast, 0);
+    for (uint32_t j = unit->lhs; j < unit->rhs; j++) {
+      declare_function(&codegen, codegen.ast->extra.data[j]);
+    }
+  }
+
+  for (size_t i = 0; i < unit_count; i++) {
+    codegen.ast = &asts[i];
+    const AstNode *unit = ast_node(codegen.ast, 0);
+    for (uint32_t j = unit->lhs; j < unit->rhs; j++) {
+      convert_declaration(&codegen, codegen.ast->extra.data[j]);
+    }
+  }
+
+  // Clean up resources
+  LLVMDisposeBuilder(codegen.builder);
+  free_symbol_table(&codegen.symbol_table);
+  free_symbol_table(&codegen.string_literals);
+  free_declaration_table(&declarations);
+
+  return codegen.llvm_module;
+}
+
+// Function to lower every file of the program into a module of its own.
+void codegen_per_unit(const Ast *asts, const char *const *names,
+                      size_t unit_count, LLVMContextRef llvm_context,
+                      LLVMModuleRef *llvm_modules, CodegenStats *stats) {
+  for (size_t i = 0; i < unit_count; i++) {
+    if (asts[i].nodes.length == 0 ||
+        ast_node(&asts[i], 0)->kind != AST_TRANSLATION_UNIT) {
+      printf("Provided node is not a translation unit.\n");
+      exit(1);
+    }
+  }
+
+  // Functions of the other files are declared as they are called.
+  DeclarationTable declarations = {0};
+  build_declaration_table(&declarations, asts, unit_count);
+
+  for (size_t i = 0; i < unit_count; i++) {
+    if (llvm_modules[i]) {
+      continue;
+    }
+
+    Codegen codegen = {0};
+    codegen.llvm_context = llvm_context;
+    codegen.llvm_module =
+        LLVMModuleCreateWithNameInContext(names[i], llvm_context);
+    codegen.builder = LLVMCreateBuilderInContext(llvm_context);
+    codegen.stats = stats;
+    codegen.asts = asts;
+    codegen.ast = &asts[i];
+    codegen.declarations = &declarations;
+
+    const AstNode *unit = ast_node(codegen.ast, 0);
+    for (uint32_t j = unit->lhs; j < unit->rhs; j++) {
+      declare_function(&codegen, codegen.ast->extra.data[j]);
+    }
+    for (uint32_t j = unit->lhs; j < unit->rhs; j++) {
+      convert_declaration(&codegen, codegen.ast->extra.data[j]);
+    }
+
+    LLVMDisposeBuilder(codegen.builder);
+    free_symbol_table(&codegen.symbol_table);
+    free_symbol_table(&codegen.string_literals);
+    llvm_modules[i] = codegen.llvm_module;
+  }
+
+  free_declaration_table(&declarations);
+}
+
+// Function to link several modules of one context into the first of them.
+void link_modules(LLVMModuleRef *llvm_modules, size_t module_count) {
+  // Linking neighbours pairwise until one module is left. Every link walks
+  // the whole destination module, so linking the modules one after another
+  // into a single module would take quadratic time.
+  for (size_t width = 1; width < module_count; width *= 2) {
+    for (size_t i = 0; i + width < module_count; i += 2 * width) {
+      if (LLVMLinkModules2(llvm_modules[i], llvm_modules[i + width])) {
+        fprintf(stderr, "Error: Failed to link module %zu\n", i + width);
+        exit(1);
+      }
+    }
+  }
+}
+
+// A function definition to lower in parallel codegen.
+typedef struct {
+  uint32_t unit;
+  AstIndex node;
+} FunctionDefinition;
+
+// Codegen Shard Defination
+// A run of consecutive function definitions, lowered and optimized in a
+// context of its own.
+typedef struct {
+  const FunctionDefinition *definitions;
+  size_t definition_count;
+  LLVMMemoryBufferRef bitcode; // The optimized shard, once finished.
+  CodegenStats stats;
+} CodegenShard;
 
-  // Creating an IR builder.
-  LLVMBuilderRef builder = LLVMCreateBuilderInContext(llvm_context);
+// State shared by the threads of parallel codegen.
+typedef struct {
+  const Ast *asts;
+  const DeclarationTable *declarations;
+  const OptimizerOptions *optimizer_options;
+  CodegenShard *shards;
+  size_t shard_count;
+  atomic_size_t next_shard;
+} ShardQueue;
+
+// Helper function to lower, verify and optimize a single shard.
+void build_shard(const ShardQueue *queue, CodegenShard *shard) {
+  LLVMContextRef llvm_context = LLVMContextCreate();
+
+  Codegen codegen = {0};
+  codegen.llvm_context = llvm_context;
+  codegen.llvm_module =
+      LLVMModuleCreateWithNameInContext("shard", llvm_context);
+  codegen.builder = LLVMCreateBuilderInContext(llvm_context);
+  codegen.stats = &shard->stats;
+  codegen.asts = queue->asts;
+  codegen.declarations = queue->declarations;
+
+  // The shard's own functions are declared up front, the functions they
+  // call are declared as they are reached.
+  for (size_t i = 0; i < shard->definition_count; i++) {
+    codegen.ast = &queue->asts[shard->definitions[i].unit];
+    declare_function(&codegen, shard->definitions[i].node);
+  }
+  for (size_t i = 0; i < shard->definition_count; i++) {
+    codegen.ast = &queue->asts[shard->definitions[i].unit];
+    convert_declaration(&codegen, shard->definitions[i].node);
+  }
+
+  LLVMDisposeBuilder(codegen.builder);
+  free_symbol_table(&codegen.symbol_table);
+  free_symbol_table(&codegen.string_literals);
+
+  verify_module(codegen.llvm_module);
+  LLVMTargetMachineRef target_machine = create_host_target_machine(
+      codegen.llvm_module, queue->optimizer_options->level);
+  optimize_module(codegen.llvm_module, target_machine,
+                  queue->optimizer_options);
+  LLVMDisposeTargetMachine(target_machine);
+
+  // Modules can only be linked within one context, so the shard is handed
+  // over as bitcode.
+  shard->bitcode = LLVMWriteBitcodeToMemoryBuffer(codegen.llvm_module);
+  LLVMDisposeModule(codegen.llvm_module);
+  LLVMContextDispose(llvm_context);
+}
+
+// Helper function run by every codegen thread, taking shards off the queue
+// until it is empty.
+void *shard_worker(void *argument) {
+  ShardQueue *queue = argument;
+  for (;;) {
+    size_t index = atomic_fetch_add(&queue->next_shard, 1);
+    if (index >= queue->shard_count) {
+      return NULL;
+    }
+    build_shard(queue, &queue->shards[index]);
+  }
+}
+
+// Function to lower and optimize the syntax trees on several threads,
+// linking the results into a single LLVM module.
+LLVMModuleRef codegen_parallel(const Ast *asts, size_t unit_count,
+                               LLVMContextRef llvm_context,
+                               const OptimizerOptions *optimizer_options,
+                               unsigned thread_count, CodegenStats *stats) {
+  for (size_t i = 0; i < unit_count; i++) {
+    if (asts[i].nodes.length == 0 ||
+        ast_node(&asts[i], 0)->kind != AST_TRANSLATION_UNIT) {
+      printf("Provided node is not a translation unit.\n");
+      exit(1);
+    }
+  }
+
+  // Indexing every declaration and collecting the definitions in source
+  // order.
+  DeclarationTable declarations = {0};
+  build_declaration_table(&declarations, asts, unit_count);
+
+  Vector(FunctionDefinition) definitions;
+  vec_init(FunctionDefinition, &definitions);
+  for (size_t i = 0; i < unit_count; i++) {
+    const AstNode *unit = ast_node(&asts[i], 0);
+    for (uint32_t j = unit->lhs; j < unit->rhs; j++) {
+      AstIndex index = asts[i].extra.data[j];
+      if (ast_node(&asts[i], index)->kind == AST_FUNCTION_DECLARATION) {
+        FunctionDefinition definition = {.unit = (uint32_t)i, .node = index};
+        vec_push(FunctionDefinition, &definitions, definition);
+      }
+    }
+  }
+
+  // Shards hold a fixed number of functions whatever the thread count, so
+  // the linked module is the same for every thread count.
+  size_t shard_count =
+      (definitions.length + CODEGEN_SHARD_FUNCTIONS - 1) /
+      CODEGEN_SHARD_FUNCTIONS;
+  CodegenShard *shards = calloc(shard_count + 1, sizeof(CodegenShard));
+  if (!shards) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(1);
+  }
+  for (size_t i = 0; i < shard_count; i++) {
+    size_t first = i * CODEGEN_SHARD_FUNCTIONS;
+    shards[i].definitions = definitions.data + first;
+    shards[i].definition_count = definitions.length - first;
+    if (shards[i].definition_count > CODEGEN_SHARD_FUNCTIONS) {
+      shards[i].definition_count = CODEGEN_SHARD_FUNCTIONS;
+    }
+  }
 
-  // Clear symbol table
-  symbol_table.count = 0;
+  ShardQueue queue = {.asts = asts,
+                      .declarations = &declarations,
+                      .optimizer_options = optimizer_options,
+                      .shards = shards,
+                      .shard_count = shard_count};
+  atomic_init(&queue.next_shard, 0);
 
-  // Process all declarations by calling convert_declaration
-  for (int i = 0;
-       i < (int)translation_unit->as.translation_unit.declarations.length;
-       i++) {
-    AstNode *node = translation_unit->as.translation_unit.declarations.data[i];
-    convert_declaration(node, llvm_module, llvm_context, builder);
+  // The target is initialised before any thread needs it, and LLVM's pass
+  // timers are process wide, so timing passes keeps to a single thread.
+  initialise_native_target();
+  if (thread_count == 0 || optimizer_options->time_passes) {
+    thread_count = 1;
   }
+  if (thread_count > shard_count) {
+    thread_count = shard_count > 0 ? (unsigned)shard_count : 1;
+  }
+
+  // The calling thread works through the queue as well.
+  pthread_t *threads = malloc(thread_count * sizeof(pthread_t));
+  if (!threads) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(1);
+  }
+  for (unsigned i = 1; i < thread_count; i++) {
+    if (pthread_create(&threads[i], NULL, shard_worker, &queue) != 0) {
+      fprintf(stderr, "Error: Failed to start a codegen thread\n");
+      exit(1);
+    }
+  }
+  shard_worker(&queue);
+  for (unsigned i = 1; i < thread_count; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+
+  // Reading the shards back into the main context, behind the module which
+  // receives them. A program without any definition still needs a module.
+  size_t module_count = shard_count + 1;
+  LLVMModuleRef *modules = malloc(module_count * sizeof(LLVMModuleRef));
+  if (!modules) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(1);
+  }
+  modules[0] = LLVMModuleCreateWithNameInContext("main_module", llvm_context);
+  for (size_t i = 0; i < shard_count; i++) {
+    if (LLVMParseBitcodeInContext2(llvm_context, shards[i].bitcode,
+                                   &modules[i + 1])) {
+      fprintf(stderr, "Error: Failed to read back codegen shard %zu\n", i);
+      exit(1);
+    }
+    LLVMDisposeMemoryBuffer(shards[i].bitcode);
+
+    stats->string_literals += shards[i].stats.string_literals;
+    stats->unique_string_literals += shards[i].stats.unique_string_literals;
+  }
+  if (shard_count > 0) {
+    LLVMSetTarget(modules[0], LLVMGetTarget(modules[1]));
+    LLVMSetDataLayout(modules[0], LLVMGetDataLayoutStr(modules[1]));
+  }
+
+  link_modules(modules, module_count);
+  LLVMModuleRef llvm_module = modules[0];
+  free(modules);
+
+  free(shards);
+  vec_free(FunctionDefinition, &definitions);
+  free_declaration_table(&declarations);
 
-  // Returning the IR back.
+  return llvm_module;
+}
+
+// Function to verify a module, exiting with the verifier's report if it is
+// malformed.
+void verify_module(LLVMModuleRef llvm_module) {
   char *err = NULL;
   if (LLVMVerifyModule(llvm_module, LLVMReturnStatusAction, &err)) {
     fprintf(stderr, "Failed to verify the module: %s\n", err);
     LLVMDisposeMessage(err);
-    LLVMDisposeBuilder(builder);
-    LLVMDisposeModule(llvm_module);
-    LLVMContextDispose(llvm_context);
     exit(1);
   }
   if (err)
     LLVMDisposeMessage(err);
+}
 
-  char *ir = LLVMPrintModuleToString(llvm_module);
-
-  // Clean up resources
-  LLVMDisposeBuilder(builder);
-  LLVMDisposeModule(llvm_module);
-  LLVMContextDispose(llvm_context);
-
-  // Clean up symbol table
-  for (size_t i = 0; i < symbol_table.count; i++) {
-    free(symbol_table.functions[i].name);
-  }
-  if (symbol_table.functions) {
-    free(symbol_table.functions);
-    symbol_table.functions = NULL;
-    symbol_table.count = 0;
-    symbol_table.capacity = 0;
-  }
-
-  return ir;
-}
\ No newline at end of file
+// Function to print the codegen statistics.
+void codegen_print_stats(const CodegenStats *stats, FILE *stream) {
+  fprintf(stream,
+          "codegen: %zu string literals lowered to %zu globals "
+          "(%zu duplicates collapsed)\n",
+          stats->string_literals, stats->unique_string_literals,
+          stats->string_literals - stats->unique_string_literals);
+}
@@ -0,0 +1,161 @@
+#include "include/emit.h"
+#include "llvm-c/BitWriter.h"
+#include "llvm-c/Core.h"
+#include "llvm-c/Target.h"
+#include "llvm-c/TargetMachine.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Function to obtain the usual file extension of an output format.
+const char *emit_extension(EmitKind kind) {
+  switch (kind) {
+  case EMIT_LLVM_IR:
+    return "ll";
+  case EMIT_BITCODE:
+    return "bc";
+  case EMIT_ASSEMBLY:
+    return "s";
+  case EMIT_OBJECT:
+    return "o";
+  }
+
+  return "out";
+}
+
+// Helper function to initialise the native backend once per process.
+void initialise_native_target(void) {
+  static bool initialised = false;
+  if (initialised) {
+    return;
+  }
+
+  if (LLVMInitializeNativeTarget() || LLVMInitializeNativeAsmPrinter()) {
+    fprintf(stderr, "Error: The host target is not supported by LLVM.\n");
+    exit(1);
+  }
+  initialised = true;
+}
+
+// Function to create a target machine for the host triple.
+// The module's triple and data layout are set to match it.
+LLVMTargetMachineRef create_host_target_machine(LLVMModuleRef llvm_module,
+                                                unsigned optimization_level) {
+  initialise_native_target();
+
+  char *triple = LLVMGetDefaultTargetTriple();
+  LLVMTargetRef target = NULL;
+  char *err = NULL;
+  if (LLVMGetTargetFromTriple(triple, &target, &err)) {
+    fprintf(stderr, "Failed to find the target for %s: %s\n", triple, err);
+    LLVMDisposeMessage(err);
+    exit(1);
+  }
+
+  LLVMCodeGenOptLevel codegen_level = LLVMCodeGenLevelNone;
+  if (optimization_level == 1) {
+    codegen_level = LLVMCodeGenLevelLess;
+  } else if (optimization_level == 2) {
+    codegen_level = LLVMCodeGenLevelDefault;
+  } else if (optimization_level >= 3) {
+    codegen_level = LLVMCodeGenLevelAggressive;
+  }
+
+  LLVMTargetMachineRef target_machine =
+      LLVMCreateTargetMachine(target, triple, "generic", "", codegen_level,
+                              LLVMRelocPIC, LLVMCodeModelDefault);
+
+  // The optimizer relies on the data layout to reason about memory.
+  LLVMSetTarget(llvm_module, triple);
+  LLVMTargetDataRef data_layout = LLVMCreateTargetDataLayout(target_machine);
+  LLVMSetModuleDataLayout(llvm_module, data_layout);
+  LLVMDisposeTargetData(data_layout);
+
+  LLVMDisposeMessage(triple);
+  return target_machine;
+}
+
+// Helper function to write the textual IR of a module.
+void emit_llvm_ir(LLVMModuleRef llvm_module, const char *output_path) {
+  if (!output_path) {
+    char *ir = LLVMPrintModuleToString(llvm_module);
+    fputs(ir, stdout);
+    LLVMDisposeMessage(ir);
+    return;
+  }
+
+  char *err = NULL;
+  if (LLVMPrintModuleToFile(llvm_module, output_path, &err)) {
+    fprintf(stderr, "Failed to write %s: %s\n", output_path, err);
+    LLVMDisposeMessage(err);
+    exit(1);
+  }
+}
+
+// Helper function to write the bitcode of a module.
+void emit_bitcode(LLVMModuleRef llvm_module, const char *output_path) {
+  if (output_path) {
+    if (LLVMWriteBitcodeToFile(llvm_module, output_path) != 0) {
+      fprintf(stderr, "Failed to write %s\n", output_path);
+      exit(1);
+    }
+    return;
+  }
+
+  // Serialising in memory first, so stdout receives a single write.
+  LLVMMemoryBufferRef buffer = LLVMWriteBitcodeToMemoryBuffer(llvm_module);
+  fwrite(LLVMGetBufferStart(buffer), 1, LLVMGetBufferSize(buffer), stdout);
+  LLVMDisposeMemoryBuffer(buffer);
+}
+
+// Helper function to run the backend over a module.
+void emit_machine_code(LLVMModuleRef llvm_module,
+                       LLVMTargetMachineRef target_machine,
+                       LLVMCodeGenFileType file_type,
+                       const char *output_path) {
+  char *err = NULL;
+  if (output_path) {
+    // LLVM takes a mutable path, even though it never writes to it.
+    if (LLVMTargetMachineEmitToFile(target_machine, llvm_module,
+                                    (char *)output_path, file_type, &err)) {
+      fprintf(stderr, "Failed to write %s: %s\n", output_path, err);
+      LLVMDisposeMessage(err);
+      exit(1);
+    }
+    return;
+  }
+
+  LLVMMemoryBufferRef buffer = NULL;
+  if (LLVMTargetMachineEmitToMemoryBuffer(target_machine, llvm_module,
+                                          file_type, &err, &buffer)) {
+    fprintf(stderr, "Failed to emit machine code: %s\n", err);
+    LLVMDisposeMessage(err);
+    exit(1);
+  }
+
+  fwrite(LLVMGetBufferStart(buffer), 1, LLVMGetBufferSize(buffer), stdout);
+  LLVMDisposeMemoryBuffer(buffer);
+}
+
+// Function to write the module in the requested format.
+// A NULL output path writes to stdout.
+void emit_module(LLVMModuleRef llvm_module,
+                 LLVMTargetMachineRef target_machine, EmitKind kind,
+                 const char *output_path) {
+  switch (kind) {
+  case EMIT_LLVM_IR:
+    emit_llvm_ir(llvm_module, output_path);
+    break;
+  case EMIT_BITCODE:
+    emit_bitcode(llvm_module, output_path);
+    break;
+  case EMIT_ASSEMBLY:
+    emit_machine_code(llvm_module, target_machine, LLVMAssemblyFile,
+                      output_path);
+    break;
+  case EMIT_OBJECT:
+    emit_machine_code(llvm_module, target_machine, LLVMObjectFile,
+                      output_path);
+    break;
+  }
+}
@@ -0,0 +1,213 @@
+#include "include/fold.h"
+#include "include/ast.h"
+#include "include/lexer.h"
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Helper function to obtain the value of an integer operand. Returns false
+// when the operand is not constant or does not fit in 64 bits.
+static bool integer_operand(const Ast *ast, AstIndex index, int64_t *value) {
+  const AstNode *node = ast_node(ast, index);
+  if (node->kind == AST_CONSTANT_EXPRESSION) {
+    *value = ast_constant_value(node);
+    return true;
+  }
+  if (node->kind != AST_INT_LITERAL_EXPRESSION) {
+    return false;
+  }
+
+  // The literal is always followed by a non-digit character.
+  errno = 0;
+  unsigned long long literal =
+      strtoull(ast_token(ast, node->main_token).start_ptr, NULL, 10);
+  if (errno == ERANGE || literal > INT64_MAX) {
+    return false;
+  }
+
+  *value = (int64_t)literal;
+  return true;
+}
+
+// Helper function to replace a node by an integer constant.
+static void make_integer_constant(AstNode *node, int64_t value) {
+  node->kind = AST_CONSTANT_EXPRESSION;
+  node->lhs = (uint32_t)(uint64_t)value;
+  node->rhs = (uint32_t)((uint64_t)value >> 32);
+}
+
+// Helper function to replace a node by a bool constant.
+static void make_bool_constant(AstNode *node, bool value) {
+  node->kind = AST_BOOL_LITERAL_EXPRESSION;
+  node->lhs = value;
+  node->rhs = 0;
+}
+
+// Helper function to fold a binary operator on two bool constants.
+static void fold_bool_binary(AstNode *node, TokenKind operator, bool lhs,
+                             bool rhs) {
+  switch (operator) {
+  case TOKEN_AND_AND:
+  case TOKEN_AMPERSAND:
+    make_bool_constant(node, lhs && rhs);
+    break;
+  case TOKEN_OR_OR:
+  case TOKEN_PIPE:
+    make_bool_constant(node, lhs || rhs);
+    break;
+  case TOKEN_CARET:
+  case TOKEN_BANG_EQUAL:
+    make_bool_constant(node, lhs != rhs);
+    break;
+  case TOKEN_EQUAL_EQUAL:
+    make_bool_constant(node, lhs == rhs);
+    break;
+  default:
+    // Not defined on bools, codegen reports it.
+    break;
+  }
+}
+
+// Helper function to fold a binary operator on two integer constants.
+// Results which overflow 64 bits are left alone.
+static void fold_integer_binary(AstNode *node, TokenKind operator,
+                                int64_t lhs, int64_t rhs) {
+  int64_t result;
+  switch (operator) {
+  case TOKEN_PLUS:
+    if (!__builtin_add_overflow(lhs, rhs, &result)) {
+      make_integer_constant(node, result);
+    }
+    break;
+  case TOKEN_MINUS:
+    if (!__builtin_sub_overflow(lhs, rhs, &result)) {
+      make_integer_constant(node, result);
+    }
+    break;
+  case TOKEN_STAR:
+    if (!__builtin_mul_overflow(lhs, rhs, &result)) {
+      make_integer_constant(node, result);
+    }
+    break;
+  case TOKEN_SLASH:
+    if (!(lhs == INT64_MIN && rhs == -1)) {
+      make_integer_constant(node, lhs / rhs);
+    }
+    break;
+  case TOKEN_PERCENT:
+    if (!(lhs == INT64_MIN && rhs == -1)) {
+      make_integer_constant(node, lhs % rhs);
+    }
+    break;
+  case TOKEN_AMPERSAND:
+    make_integer_constant(node, lhs & rhs);
+    break;
+  case TOKEN_PIPE:
+    make_integer_constant(node, lhs | rhs);
+    break;
+  case TOKEN_CARET:
+    make_integer_constant(node, lhs ^ rhs);
+    break;
+  case TOKEN_SHIFT_LEFT:
+    if (rhs >= 0 && rhs < 63 && lhs >= 0 && lhs <= (INT64_MAX >> rhs)) {
+      make_integer_constant(node, lhs << rhs);
+    }
+    break;
+  case TOKEN_SHIFT_RIGHT:
+    if (rhs >= 0 && rhs < 64) {
+      make_integer_constant(node, lhs >> rhs);
+    }
+    break;
+  case TOKEN_EQUAL_EQUAL:
+    make_bool_constant(node, lhs == rhs);
+    break;
+  case TOKEN_BANG_EQUAL:
+    make_bool_constant(node, lhs != rhs);
+    break;
+  case TOKEN_LESS:
+    make_bool_constant(node, lhs < rhs);
+    break;
+  case TOKEN_LESS_EQUAL:
+    make_bool_constant(node, lhs <= rhs);
+    break;
+  case TOKEN_GREATER:
+    make_bool_constant(node, lhs > rhs);
+    break;
+  case TOKEN_GREATER_EQUAL:
+    make_bool_constant(node, lhs >= rhs);
+    break;
+  default:
+    // Not defined on integers, codegen reports it.
+    break;
+  }
+}
+
+// Helper function to fold a binary expression whose operands are constant.
+static void fold_binary(Ast *ast, AstNode *node) {
+  TokenKind operator = (TokenKind)ast->tokens.kinds[node->main_token];
+  const AstNode *lhs = ast_node(ast, node->lhs);
+  const AstNode *rhs = ast_node(ast, node->rhs);
+
+  int64_t lhs_value, rhs_value;
+  bool rhs_constant = integer_operand(ast, node->rhs, &rhs_value);
+  if ((operator == TOKEN_SLASH || operator == TOKEN_PERCENT) &&
+      rhs_constant && rhs_value == 0) {
+    fprintf(stderr, "Error: Division by zero (line %zu)\n",
+            ast_token_line(ast, node->main_token));
+    exit(1);
+  }
+
+  if (lhs->kind == AST_BOOL_LITERAL_EXPRESSION &&
+      rhs->kind == AST_BOOL_LITERAL_EXPRESSION) {
+    fold_bool_binary(node, operator, lhs->lhs, rhs->lhs);
+  } else if (rhs_constant && integer_operand(ast, node->lhs, &lhs_value)) {
+    fold_integer_binary(node, operator, lhs_value, rhs_value);
+  }
+}
+
+// Helper function to fold a unary expression whose operand is constant.
+static void fold_unary(Ast *ast, AstNode *node) {
+  TokenKind operator = (TokenKind)ast->tokens.kinds[node->main_token];
+  const AstNode *operand = ast_node(ast, node->lhs);
+
+  if (operator == TOKEN_BANG) {
+    if (operand->kind == AST_BOOL_LITERAL_EXPRESSION) {
+      make_bool_constant(node, !operand->lhs);
+    }
+    return;
+  }
+
+  int64_t value;
+  if (!integer_operand(ast, node->lhs, &value)) {
+    // The one literal which only fits once negated.
+    if (operator == TOKEN_MINUS &&
+        operand->kind == AST_INT_LITERAL_EXPRESSION &&
+        strtoull(ast_token(ast, operand->main_token).start_ptr, NULL, 10) ==
+            (uint64_t)INT64_MAX + 1) {
+      make_integer_constant(node, INT64_MIN);
+    }
+    return;
+  }
+
+  if (operator == TOKEN_MINUS && value != INT64_MIN) {
+    make_integer_constant(node, -value);
+  } else if (operator == TOKEN_TILDE) {
+    make_integer_constant(node, ~value);
+  }
+}
+
+// Function to evaluate the constant operators of a syntax tree in place.
+void fold_constants(Ast *ast) {
+  // Children are always added before their parent, so a single pass in
+  // index order sees the operands of every node already folded.
+  for (size_t i = 1; i < ast->nodes.length; i++) {
+    AstNode *node = &ast->nodes.data[i];
+    if (node->kind == AST_BINARY_EXPRESSION) {
+      fold_binary(ast, node);
+    } else if (node->kind == AST_UNARY_EXPRESSION) {
+      fold_unary(ast, node);
+    }
+  }
+}
@@ -0,0 +1,179 @@
+#include "include/frontend.h"
+#include "include/ast.h"
+#include "include/fold.h"
+#include "include/intern.h"
+#include "include/lexer.h"
+#include "include/parser.h"
+#include "include/source.h"
+#include "include/timer.h"
+#include "include/tokens.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Function to lex and parse a single mapped source file.
+void frontend_parse_source(const SourceFile *source, Ast *ast,
+                           bool pretokenize, TimeReport *time_report) {
+  // Initalising the lexer and the tree.
+  Lexer lexer;
+  lexer_init(&lexer, source->contents);
+  ast_init(ast, source->contents, source->size);
+
+  // Initalising the parser.
+  Parser parser;
+  if (!pretokenize) {
+    parser_init(&parser, &lexer, ast);
+
+    // Generating a translation unit, the lexer runs on demand.
+    time_report_begin(time_report, "lex+parse");
+    parse_translation_unit(&parser);
+  } else {
+    // Lexing the whole file first.
+    time_report_begin(time_report, "lex");
+    token_buffer_fill(&ast->tokens, &lexer);
+    time_report_end(time_report);
+
+    parser_init_tokens(&parser, ast);
+    time_report_begin(time_report, "parse");
+    parse_translation_unit(&parser);
+  }
+  time_report_end(time_report);
+  parser_free(&parser);
+
+  time_report_begin(time_report, "fold");
+  fold_constants(ast);
+  time_report_end(time_report);
+}
+
+// Files waiting to be parsed, shared by the front end threads.
+typedef struct {
+  const SourceFile *sources;
+  Ast *asts;
+  size_t count;
+  bool pretokenize;
+  atomic_size_t next_file;
+  unsigned *file_workers; // Worker that parsed each file.
+} FrontendQueue;
+
+// State of a single front end thread.
+typedef struct {
+  FrontendQueue *queue;
+  unsigned index;
+  InternPool strings; // Everything interned while parsing the worker's files.
+} FrontendWorker;
+
+// Helper function run by every front end thread, taking files off the queue
+// until it is empty.
+void *frontend_worker(void *argument) {
+  FrontendWorker *worker = argument;
+  FrontendQueue *queue = worker->queue;
+
+  // Interning into a pool of its own, so the threads never wait on each other.
+  intern_begin_local(&worker->strings);
+  for (;;) {
+    size_t index = atomic_fetch_add(&queue->next_file, 1);
+    if (index >= queue->count) {
+      intern_end_local();
+      return NULL;
+    }
+    frontend_parse_source(&queue->sources[index], &queue->asts[index],
+                          queue->pretokenize, NULL);
+    queue->file_workers[index] = worker->index;
+  }
+}
+
+// Helper function to move the strings interned by the front end threads into
+// the global pool and to renumber the tokens referring to them. Files are
+// visited in order, so the global identifiers come out the same as when a
+// single thread parses every file.
+static void frontend_merge_strings(FrontendQueue *queue,
+                                   FrontendWorker *workers,
+                                   unsigned thread_count) {
+  // Global identifier of every local one, zero until it has been merged.
+  InternId **remaps = malloc(thread_count * sizeof(InternId *));
+  if (!remaps) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(1);
+  }
+  for (unsigned i = 0; i < thread_count; i++) {
+    remaps[i] = calloc(workers[i].strings.strings.length, sizeof(InternId));
+    if (!remaps[i]) {
+      fprintf(stderr, "Memory allocation failed\n");
+      exit(1);
+    }
+  }
+
+  for (size_t i = 0; i < queue->count; i++) {
+    unsigned worker = queue->file_workers[i];
+    InternId *remap = remaps[worker];
+    TokenBuffer *tokens = &queue->asts[i].tokens;
+    for (size_t j = 0; j < tokens->count; j++) {
+      if (!token_has_intern_id((TokenKind)tokens->kinds[j])) {
+        continue;
+      }
+
+      InternId id = tokens->intern_ids[j];
+      if (remap[id] == INTERN_NONE) {
+        remap[id] = intern_merge(&workers[worker].strings, id);
+      }
+      tokens->intern_ids[j] = remap[id];
+    }
+  }
+
+  for (unsigned i = 0; i < thread_count; i++) {
+    free(remaps[i]);
+  }
+  free(remaps);
+}
+
+// Function to lex and parse several mapped source files on a pool of
+// threads.
+void frontend_parse_sources(const SourceFile *sources, size_t count, Ast *asts,
+                            bool pretokenize, unsigned thread_count) {
+  FrontendQueue queue = {.sources = sources,
+                         .asts = asts,
+                         .count = count,
+                         .pretokenize = pretokenize};
+  atomic_init(&queue.next_file, 0);
+
+  if (thread_count > count) {
+    thread_count = (unsigned)count;
+  }
+  if (thread_count == 0) {
+    thread_count = 1;
+  }
+
+  pthread_t *threads = malloc(thread_count * sizeof(pthread_t));
+  FrontendWorker *workers = malloc(thread_count * sizeof(FrontendWorker));
+  queue.file_workers = malloc(count * sizeof(unsigned));
+  if (!threads || !workers || !queue.file_workers) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(1);
+  }
+  for (unsigned i = 0; i < thread_count; i++) {
+    workers[i].queue = &queue;
+    workers[i].index = i;
+    intern_pool_init(&workers[i].strings);
+  }
+
+  // The calling thread parses files as well.
+  for (unsigned i = 1; i < thread_count; i++) {
+    if (pthread_create(&threads[i], NULL, frontend_worker, &workers[i]) != 0) {
+      fprintf(stderr, "Error: Failed to start a front end thread\n");
+      exit(1);
+    }
+  }
+  frontend_worker(&workers[0]);
+  for (unsigned i = 1; i < thread_count; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  frontend_merge_strings(&queue, workers, thread_count);
+  for (unsigned i = 0; i < thread_count; i++) {
+    intern_pool_free(&workers[i].strings);
+  }
+  free(queue.file_workers);
+  free(workers);
+  free(threads);
+}
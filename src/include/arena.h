@@ -0,0 +1,37 @@
+#ifndef FERRO_LANG_ARENA
+#define FERRO_LANG_ARENA
+
+#include <stddef.h>
+
+// Default size of a chunk requested from the system allocator.
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+// A block of memory owned by the arena.
+// The usable bytes directly follow the header.
+typedef struct ArenaChunk {
+  struct ArenaChunk *next;
+  size_t capacity;
+  size_t used;
+} ArenaChunk;
+
+// Arena Defination
+// Bump-pointer allocator, everything handed out by it lives until arena_free.
+typedef struct {
+  ArenaChunk *head;
+
+  // Statistics
+  size_t chunk_count;     // Calls to the system allocator.
+  size_t bytes_requested; // Bytes asked for by callers.
+  size_t peak_bytes;      // Bytes held from the system allocator.
+} Arena;
+
+// Function to initialise the arena.
+void arena_init(Arena *arena);
+
+// Function to allocate zeroed memory from the arena.
+void *arena_alloc(Arena *arena, size_t size);
+
+// Function to release every chunk of the arena at once.
+void arena_free(Arena *arena);
+
+#endif
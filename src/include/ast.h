@@ -3,120 +3,186 @@
 
 #include "helpers.h"
 #include "lexer.h"
-#include "stdbool.h"
+#include "tokens.h"
+#include <stdint.h>
+#include <stdio.h>
+
+// Index of a node in Ast.nodes. Node 0 is always the translation unit,
+// which is never anyone's child, so 0 doubles as "no node".
+typedef uint32_t AstIndex;
+#define AST_NONE 0
+
+// Index of a token in Ast.tokens.
+typedef uint32_t TokenIndex;
 
 // Possible node categories.
+// The comment on each kind describes what its main_token, lhs and rhs hold.
+// A child list [lhs, rhs) is a range of node indices in Ast.extra.
 typedef enum {
   // Declarations.
-  AST_TRANSLATION_UNIT,
-  AST_FUNCTION_DECLARATION,
-  AST_FOREIGN_DECLARATION,
+  AST_TRANSLATION_UNIT,     // first token, declarations in extra[lhs, rhs)
+  AST_FUNCTION_DECLARATION, // return type (the name follows it, the
+                            // annotations precede it),
+                            // extra[lhs] .. extra[lhs + 1] parameters,
+                            // rhs block
+  AST_FOREIGN_DECLARATION,  // return type (the name follows it, the symbol
+                            // name is 2 and the source path 4 tokens before
+                            // it, the annotations precede the @foreign 6
+                            // tokens before it), parameters in
+                            // extra[lhs, rhs)
 
   // Node
-  AST_PARAMETER,
+  AST_PARAMETER, // type, lhs is 1 for a tail parameter (the name follows the
+                 // type, or the '...' of a tail parameter), rhs holds
+                 // AST_PARAMETER_* flags
 
   // Statements
-  AST_BLOCK_STATEMENT,
-  AST_RETURN_STATEMENT,
+  AST_BLOCK_STATEMENT,    // '{', statements in extra[lhs, rhs)
+  AST_RETURN_STATEMENT,   // 'return', lhs value or AST_NONE
+  AST_LET_STATEMENT,      // name, lhs value, rhs type token or 0 when the
+                          // type is inferred from the value
+  AST_ASSIGN_STATEMENT,   // '=', lhs target, rhs value
+  AST_IF_STATEMENT,       // 'if', lhs condition, extra[rhs] then block,
+                          // extra[rhs + 1] else block, if statement or
+                          // AST_NONE
+  AST_WHILE_STATEMENT,    // 'while', lhs condition, rhs body
+  AST_FOR_STATEMENT,      // 'for', extra[lhs] .. extra[lhs + 2] init,
+                          // condition and step (each AST_NONE when
+                          // omitted), rhs body
+  AST_BREAK_STATEMENT,    // 'break'
+  AST_CONTINUE_STATEMENT, // 'continue'
 
   // Expressions
-  AST_INT_LITERAL_EXPRESSION,
-  AST_STRING_LITERAL_EXPRESSION,
-  AST_CALL_EXPRESSION,
-  AST_IDENTIFIER_EXPRESSION
+  AST_INT_LITERAL_EXPRESSION,    // literal
+  AST_STRING_LITERAL_EXPRESSION, // literal
+  AST_CALL_EXPRESSION,           // callee name, arguments in extra[lhs, rhs)
+  AST_IDENTIFIER_EXPRESSION,     // name
+  AST_CAST_EXPRESSION,           // integer type, lhs operand
+  AST_BINARY_EXPRESSION,         // operator, lhs and rhs operands
+  AST_UNARY_EXPRESSION,          // operator, lhs operand
+  AST_BOOL_LITERAL_EXPRESSION,   // 'true', 'false' or the operator of a
+                                 // folded expression, lhs is the value
+  AST_CONSTANT_EXPRESSION,       // operator of a folded integer expression,
+                                 // value in lhs (low 32 bits) and rhs
+                                 // (high 32 bits)
+  AST_INDEX_EXPRESSION,          // '[', lhs operand, rhs index
+  AST_SLICE_EXPRESSION,          // '[', lhs operand, extra[rhs] start and
+                                 // extra[rhs + 1] end, each AST_NONE when
+                                 // omitted
+  AST_VECTOR_EXPRESSION          // vector type, lane values in
+                                 // extra[lhs, rhs)
 } AstNodeKind;
 
-// Forward declaration for AstNode.
-struct AstNode;
-typedef struct AstNode AstNode;
-
-// Named vector type for AST nodes to avoid anonymous-struct incompatibilities
-typedef Vector(AstNode *) AstNodeVector;
-
-// Represents integers,
-// FUTURE: floats, boolean.
-typedef struct {
-  Token token;
-} AstLiteral;
-
-// Represents a string.
-typedef struct {
-  Token token;
-} AstStringLiteral;
-
-// Represents an identifer.
+// Node Defination
+// Every node takes 16 bytes, its children are found through lhs and rhs.
 typedef struct {
-  Token token;
-} AstIdentifer;
+  AstNodeKind kind;
+  TokenIndex main_token;
+  uint32_t lhs;
+  uint32_t rhs;
+} AstNode;
 
-// Represents a parameter.
-typedef struct {
-  Token parameter_type;
-  Token parameter_name;
-  bool is_tail_parameter;
-} AstParameter;
+typedef Vector(AstNode) AstNodeVector;
+typedef Vector(uint32_t) AstExtraVector;
 
-// Represents a function.
+// Ast Defination
+// The syntax tree of one source file, stored in three flat arrays.
 typedef struct {
-  Token return_type;
-  Token fn_name;
-  AstNode *block;
-  bool has_tail_arg;
-  AstNodeVector parameters;
-} AstFunctionDeclaration;
-
-// Represents a block.
+  TokenBuffer tokens;
+  AstNodeVector nodes; // nodes.data[0] is the translation unit.
+  AstExtraVector extra;
+} Ast;
+
+// Ast Memory Defination
+// Bytes held by the flat arrays of one or more syntax trees. Used bytes
+// cover the elements in use, reserved bytes every slot allocated so far.
 typedef struct {
-  AstNodeVector statements;
-} AstBlockStatement;
+  size_t token_count;
+  size_t token_bytes;
+  size_t token_reserved_bytes;
+  size_t node_count;
+  size_t node_bytes;
+  size_t node_reserved_bytes;
+  size_t extra_count;
+  size_t extra_bytes;
+  size_t extra_reserved_bytes;
+} AstMemory;
+
+// Function to initialise an empty syntax tree for a source file.
+void ast_init(Ast *ast, const char *source, size_t source_size);
+
+// Function to append a node, returning its index.
+AstIndex ast_add_node(Ast *ast, AstNodeKind kind, TokenIndex main_token,
+                      uint32_t lhs, uint32_t rhs);
+
+// Function to obtain a node.
+static inline const AstNode *ast_node(const Ast *ast, AstIndex index) {
+  return &ast->nodes.data[index];
+}
+
+// Function to obtain a token referenced by a node.
+static inline Token ast_token(const Ast *ast, TokenIndex index) {
+  return token_buffer_get(&ast->tokens, index);
+}
+
+// Function to obtain the line of a token.
+static inline size_t ast_token_line(const Ast *ast, TokenIndex index) {
+  return token_buffer_line(&ast->tokens, index);
+}
+
+// Function to obtain the value of an AST_CONSTANT_EXPRESSION.
+static inline int64_t ast_constant_value(const AstNode *node) {
+  return (int64_t)((uint64_t)node->rhs << 32 | node->lhs);
+}
+
+// Function to obtain the parameter range of a function or foreign
+// declaration, which the two kinds store differently.
+static inline void ast_declaration_parameters(const Ast *ast,
+                                              const AstNode *node,
+                                              uint32_t *params_start,
+                                              uint32_t *params_end) {
+  if (node->kind == AST_FUNCTION_DECLARATION) {
+    *params_start = ast->extra.data[node->lhs];
+    *params_end = ast->extra.data[node->lhs + 1];
+  } else {
+    *params_start = node->lhs;
+    *params_end = node->rhs;
+  }
+}
+
+// Flags of a parameter, stored in its rhs.
+enum {
+  AST_PARAMETER_SIZED = 1 << 0,   // @sized, passed as a pointer and a length
+  AST_PARAMETER_NOALIAS = 1 << 1, // @noalias, no other pointer reaches the
+                                  // characters during the call
+};
 
-// Represents a return statement.
-typedef struct {
-  AstNode *value;
-} AstReturnStatement;
+// Function to obtain the range of annotation tokens written before a
+// function or foreign declaration. They are not stored in the node, the
+// tokens before the declaration are read instead.
+static inline void ast_declaration_annotations(const Ast *ast,
+                                               const AstNode *node,
+                                               TokenIndex *start,
+                                               TokenIndex *end) {
+  *end = node->kind == AST_FOREIGN_DECLARATION ? node->main_token - 6
+                                               : node->main_token;
+  *start = *end;
+  while (*start > 0 &&
+         is_function_annotation((TokenKind)ast->tokens.kinds[*start - 1])) {
+    (*start)--;
+  }
+}
 
-// Represents whole program.
-typedef struct {
-  AstNodeVector declarations;
-} AstTranslationUnit;
-
-// Represents a function call.
-typedef struct {
-  AstNode *callee;
-  AstNodeVector arguments;
-} AstCallExpression;
+// Function to print AST to the console.
+void ast_print(const Ast *ast, AstIndex index, int indent);
 
-// Represents a foreign function.
-typedef struct {
-  Token return_type;
-  Token fn_name;
-  Token source_path;
-  Token symbol_name;
-  AstNodeVector parameters;
-} AstForeignDeclaration;
-
-struct AstNode {
-  Token token;
-  AstNodeKind kind;
-  union {
-    AstTranslationUnit translation_unit;
-    AstFunctionDeclaration function_declaration;
-    AstBlockStatement block_statement;
-    AstParameter parameter;
-    AstLiteral literal;
-    AstReturnStatement return_statement;
-    AstIdentifer identifier;
-    AstCallExpression call_expression;
-    AstForeignDeclaration foreign_declaration;
-    AstStringLiteral string_literal;
-  } as;
-};
+// Function to add the memory held by a syntax tree to a running total.
+void ast_memory_add(AstMemory *memory, const Ast *ast);
 
-// Function to generate Abstract Syntax Tree (AST).
-AstNode *ast_new(AstNodeKind kind, Token token);
+// Function to print the memory held by the syntax trees.
+void ast_memory_print(const AstMemory *memory, FILE *stream);
 
-// Function to print AST to the console.
-void ast_print(const AstNode *node, int indent);
-void ast_free(AstNode *node);
+// Function to release the syntax tree, including its tokens.
+void ast_free(Ast *ast);
 
-#endif
\ No newline at end of file
+#endif
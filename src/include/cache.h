@@ -0,0 +1,88 @@
+#ifndef FERRO_LANG_CACHE
+#define FERRO_LANG_CACHE
+
+#include "ast.h"
+#include "helpers.h"
+#include "intern.h"
+#include "source.h"
+#include "llvm-c/Core.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Directory used when --cache is given without one.
+#define CACHE_DEFAULT_DIRECTORY ".ferro-cache"
+
+// Module Cache Defination
+// Optimized bitcode of every source file, kept on disk between invocations.
+// A module is stored under a key made of the file's path and contents, the
+// flags which change the generated code, and the signatures of the
+// functions the file calls, since calls into other files are lowered
+// against them.
+typedef struct {
+  const char *directory;
+  uint64_t flags_hash; // Compiler build, target and optimization level.
+
+  // Statistics
+  size_t hits;   // Files whose module was read from the cache.
+  size_t misses; // Files which had to be lowered again.
+} ModuleCache;
+
+// A function declared by a file, with the hash of its signature.
+typedef struct {
+  InternId name;
+  uint64_t hash;
+} CacheSignature;
+
+// Cache Interface Defination
+// The parts of a file the modules of other files depend on, and the
+// functions its own module depends on.
+typedef struct {
+  Vector(CacheSignature) declarations;
+  Vector(InternId) calls; // Every callee, once, in order of first call.
+} CacheInterface;
+
+// Function to open the cache directory, creating it when needed.
+void module_cache_init(ModuleCache *cache, const char *directory,
+                       unsigned optimization_level);
+
+// Function to hash the path and contents of a source file.
+uint64_t module_cache_source_hash(const SourceFile *source);
+
+// Function to collect the interface of a parsed file.
+void module_cache_interface_init(CacheInterface *interface, const Ast *ast);
+
+// Function to release an interface.
+void module_cache_interface_free(CacheInterface *interface);
+
+// Function to look up the interface recorded for a source file, so an
+// unchanged file does not have to be parsed to obtain it.
+bool module_cache_load_interface(const ModuleCache *cache,
+                                 uint64_t source_hash,
+                                 CacheInterface *interface);
+
+// Function to record the interface of a source file.
+void module_cache_store_interface(const ModuleCache *cache,
+                                  uint64_t source_hash,
+                                  const CacheInterface *interface);
+
+// Function to derive the module key of every file of the program.
+void module_cache_keys(const ModuleCache *cache,
+                       const uint64_t *source_hashes,
+                       const CacheInterface *interfaces, size_t unit_count,
+                       uint64_t *keys);
+
+// Function to read a cached module into the context.
+// Returns NULL when the module is missing or unreadable.
+LLVMModuleRef module_cache_load(const ModuleCache *cache, uint64_t key,
+                                LLVMContextRef llvm_context);
+
+// Function to write a module to the cache.
+void module_cache_store(const ModuleCache *cache, uint64_t key,
+                        LLVMModuleRef llvm_module);
+
+// Function to print the hit and miss counts of the cache.
+void module_cache_print_stats(const ModuleCache *cache, FILE *stream);
+
+#endif
@@ -2,8 +2,52 @@
 #define FERRO_LANG_CODEGEN
 
 #include "ast.h"
+#include "llvm-c/Core.h"
+#include "optimizer.h"
+#include <stddef.h>
+#include <stdio.h>
 
-// Function to generate LLVM IR.
-const char *codegen(AstNode *translation_unit);
+// Statistics gathered while lowering a module.
+typedef struct {
+  size_t string_literals;        // String literal occurrences lowered.
+  size_t unique_string_literals; // Globals emitted for them.
+} CodegenStats;
+
+// Function to lower the syntax trees of several files into a single LLVM
+// module. Functions may be called from any of the files. The module belongs
+// to the given context and is owned by the caller.
+LLVMModuleRef codegen(const Ast *asts, size_t unit_count,
+                      LLVMContextRef llvm_context, CodegenStats *stats);
+
+// Function to lower every file of the program into a module of its own,
+// stored at the file's index in llvm_modules. Calls into other files are
+// left as declarations for the linker to resolve. Files whose module is
+// already set, e.g. from the cache, are skipped.
+void codegen_per_unit(const Ast *asts, const char *const *names,
+                      size_t unit_count, LLVMContextRef llvm_context,
+                      LLVMModuleRef *llvm_modules, CodegenStats *stats);
+
+// Function to link several modules of one context into the first of them.
+void link_modules(LLVMModuleRef *llvm_modules, size_t module_count);
+
+// Number of functions lowered together by one task of parallel codegen.
+#define CODEGEN_SHARD_FUNCTIONS 256
+
+// Function to lower and optimize the syntax trees on several threads,
+// linking the results into a single LLVM module.
+// Functions are split into shards of CODEGEN_SHARD_FUNCTIONS, each lowered,
+// verified and optimized in a context of its own. The shards are linked in
+// source order, so the module does not depend on the thread count.
+LLVMModuleRef codegen_parallel(const Ast *asts, size_t unit_count,
+                               LLVMContextRef llvm_context,
+                               const OptimizerOptions *optimizer_options,
+                               unsigned thread_count, CodegenStats *stats);
+
+// Function to verify a module, exiting with the verifier's report if it is
+// malformed.
+void verify_module(LLVMModuleRef llvm_module);
+
+// Function to print the codegen statistics.
+void codegen_print_stats(const CodegenStats *stats, FILE *stream);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,32 @@
+#ifndef FERRO_LANG_EMIT
+#define FERRO_LANG_EMIT
+
+#include "llvm-c/Core.h"
+#include "llvm-c/TargetMachine.h"
+
+// Possible output formats.
+typedef enum {
+  EMIT_LLVM_IR,  // Textual IR (.ll)
+  EMIT_BITCODE,  // LLVM bitcode (.bc)
+  EMIT_ASSEMBLY, // Native assembly (.s)
+  EMIT_OBJECT,   // Native object file (.o)
+} EmitKind;
+
+// Function to obtain the usual file extension of an output format.
+const char *emit_extension(EmitKind kind);
+
+// Function to initialise the native backend once per process.
+void initialise_native_target(void);
+
+// Function to create a target machine for the host triple.
+// The module's triple and data layout are set to match it.
+LLVMTargetMachineRef create_host_target_machine(LLVMModuleRef llvm_module,
+                                                unsigned optimization_level);
+
+// Function to write the module in the requested format.
+// A NULL output path writes to stdout.
+void emit_module(LLVMModuleRef llvm_module,
+                 LLVMTargetMachineRef target_machine, EmitKind kind,
+                 const char *output_path);
+
+#endif
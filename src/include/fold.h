@@ -0,0 +1,14 @@
+#ifndef FERRO_LANG_FOLD
+#define FERRO_LANG_FOLD
+
+#include "ast.h"
+
+// Function to evaluate the constant operators of a syntax tree in place.
+// Folded integer expressions become AST_CONSTANT_EXPRESSION nodes and
+// folded conditions AST_BOOL_LITERAL_EXPRESSION nodes. Like literals, their
+// values are exact: they take the type the context expects and must fit
+// it. Expressions whose value does not fit in 64 bits are left to codegen,
+// which computes them in their type.
+void fold_constants(Ast *ast);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef FERRO_LANG_FRONTEND
+#define FERRO_LANG_FRONTEND
+
+#include "ast.h"
+#include "source.h"
+#include "timer.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// Function to lex and parse a single mapped source file.
+// The time report may be NULL.
+void frontend_parse_source(const SourceFile *source, Ast *ast,
+                           bool pretokenize, TimeReport *time_report);
+
+// Function to lex and parse several mapped source files on a pool of
+// threads. Every file gets its own lexer and parser, and the results are
+// stored at the file's index, so they do not depend on the order files
+// finish in. Each thread interns into a pool of its own, which is merged
+// into the global pool once every thread is done.
+void frontend_parse_sources(const SourceFile *sources, size_t count, Ast *asts,
+                            bool pretokenize, unsigned thread_count);
+
+#endif
@@ -2,6 +2,7 @@
 #define FERRO_LANG_HELPERS
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -55,4 +56,14 @@
     (vec)->capacity = 0;                                                       \
   } while (0)
 
+// Function to hash a byte slice (64-bit FNV-1a).
+static inline uint64_t hash_bytes(const char *data, size_t length) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (unsigned char)data[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
 #endif
@@ -0,0 +1,76 @@
+#ifndef FERRO_LANG_INTERN
+#define FERRO_LANG_INTERN
+
+#include "arena.h"
+#include "helpers.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Identifier of an interned string, zero means "not interned".
+typedef uint32_t InternId;
+#define INTERN_NONE ((InternId)0)
+
+// Represents an interned string.
+// The bytes are always followed by a null terminator.
+typedef struct {
+  const char *data;
+  size_t length;
+  uint64_t hash;
+} InternString;
+
+// Intern Pool Defination
+// Maps every distinct byte sequence to a stable integer identifier.
+// A pool is not locked, only one thread may use it at a time. Threads that
+// intern at the same time each use a local pool, see intern_begin_local.
+typedef struct {
+  Arena bytes;                  // Owns the interned bytes.
+  Vector(InternString) strings; // Indexed by InternId.
+  InternId *slots;              // Open addressing table of identifiers.
+  size_t capacity;              // Always zero or a power of two.
+} InternPool;
+
+// Function to initialise an empty intern pool.
+void intern_pool_init(InternPool *pool);
+
+// Function to release an intern pool.
+void intern_pool_free(InternPool *pool);
+
+// Function to initialise the global intern pool.
+void intern_init(void);
+
+// Function to release the global intern pool.
+void intern_free(void);
+
+// Function to intern a byte slice, returning its identifier.
+// The string goes into the local pool of the calling thread if it has one,
+// otherwise into the global pool.
+InternId intern(const char *data, size_t length);
+
+// Function to make the calling thread intern into its own pool.
+// Identifiers handed out until intern_end_local belong to that pool, they
+// have to be passed through intern_merge before being looked up.
+void intern_begin_local(InternPool *pool);
+
+// Function to make the calling thread intern into the global pool again.
+void intern_end_local(void);
+
+// Function to move a string of a local pool into the global pool, returning
+// its identifier there. Only one thread may merge at a time, and no other
+// thread may intern into the global pool meanwhile.
+InternId intern_merge(const InternPool *pool, InternId id);
+
+// Function to obtain the number of distinct interned strings.
+size_t intern_count(void);
+
+// Function to obtain the interned string for an identifier of the global
+// pool. Any number of threads may look strings up, as long as none interns
+// into the global pool meanwhile: growing it moves the table of strings, so
+// the returned pointer is only valid until the next string is added. The
+// bytes it points to never move.
+const InternString *intern_get(InternId id);
+
+// Function to print the memory held by the global intern pool.
+void intern_print_stats(FILE *stream);
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef FERRO_LANG_JIT
+#define FERRO_LANG_JIT
+
+#include "llvm-c/Core.h"
+#include "llvm-c/Orc.h"
+
+// Function to JIT compile a module in-process and call its `main`.
+// The module must belong to the thread safe context, the JIT takes
+// ownership of it. Returns the value returned by `main`.
+int jit_run_main(LLVMModuleRef llvm_module,
+                 LLVMOrcThreadSafeContextRef thread_safe_context);
+
+#endif
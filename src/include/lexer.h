@@ -1,15 +1,66 @@
 #ifndef FERRO_LANG_LEXER
 #define FERRO_LANG_LEXER
 
+#include "intern.h"
+#include <stdbool.h>
 #include <stdlib.h>
 
 // Avaiable Token Possibilites.
 typedef enum {
-  TOKEN_INT,
+  TOKEN_INT, // Same as i32.
   TOKEN_VOID,
   TOKEN_STRING,
+  TOKEN_BOOL,
+
+  // Sized integer types
+  TOKEN_I8,
+  TOKEN_I16,
+  TOKEN_I32,
+  TOKEN_I64,
+  TOKEN_U8,
+  TOKEN_U16,
+  TOKEN_U32,
+  TOKEN_U64,
+
+  // Vector types, 128 and 256 bits wide
+  TOKEN_I8X16,
+  TOKEN_I16X8,
+  TOKEN_I32X4,
+  TOKEN_I64X2,
+  TOKEN_U8X16,
+  TOKEN_U16X8,
+  TOKEN_U32X4,
+  TOKEN_U64X2,
+  TOKEN_I8X32,
+  TOKEN_I16X16,
+  TOKEN_I32X8,
+  TOKEN_I64X4,
+  TOKEN_U8X32,
+  TOKEN_U16X16,
+  TOKEN_U32X8,
+  TOKEN_U64X4,
+
   TOKEN_RETURN,
   TOKEN_FOREIGN,
+  TOKEN_SIZED,
+  TOKEN_NOALIAS,
+
+  // Annotations of functions
+  TOKEN_INLINE,
+  TOKEN_NOINLINE,
+  TOKEN_PURE,
+  TOKEN_COLD,
+  TOKEN_NOUNWIND,
+
+  TOKEN_TRUE,
+  TOKEN_FALSE,
+  TOKEN_LET,
+  TOKEN_IF,
+  TOKEN_ELSE,
+  TOKEN_WHILE,
+  TOKEN_FOR,
+  TOKEN_BREAK,
+  TOKEN_CONTINUE,
 
   // Literals
   TOKEN_IDENTIFIER,
@@ -21,10 +72,36 @@ typedef enum {
   TOKEN_RPAREN,
   TOKEN_LBRACE,
   TOKEN_RBRACE,
+  TOKEN_LBRACKET,
+  TOKEN_RBRACKET,
+  TOKEN_COLON,
   TOKEN_SEMICOLON,
   TOKEN_COMMA,
   TOKEN_TAIL, // ...
 
+  // Operators
+  TOKEN_PLUS,
+  TOKEN_MINUS,
+  TOKEN_STAR,
+  TOKEN_SLASH,
+  TOKEN_PERCENT,
+  TOKEN_AMPERSAND,
+  TOKEN_PIPE,
+  TOKEN_CARET,
+  TOKEN_TILDE,
+  TOKEN_BANG,
+  TOKEN_SHIFT_LEFT,    // <<
+  TOKEN_SHIFT_RIGHT,   // >>
+  TOKEN_AND_AND,       // &&
+  TOKEN_OR_OR,         // ||
+  TOKEN_EQUAL_EQUAL,   // ==
+  TOKEN_BANG_EQUAL,    // !=
+  TOKEN_LESS,          // <
+  TOKEN_LESS_EQUAL,    // <=
+  TOKEN_GREATER,       // >
+  TOKEN_GREATER_EQUAL, // >=
+  TOKEN_EQUAL,         // =
+
   // EOF
   TOKEN_EOF
 } TokenKind;
@@ -36,6 +113,7 @@ typedef struct {
   size_t length;
 
   TokenKind kind;
+  InternId intern_id; // Identifier name or unescaped string literal value.
   const char *start_ptr;
 } Token;
 
@@ -56,6 +134,29 @@ void lexer_init(Lexer *lexer, const char *source_code);
 // Function to convert the token kind to string.
 const char *token_kind_to_string(TokenKind token_kind);
 
+// Function to check whether a token names an integer type.
+bool is_integer_type(TokenKind token_kind);
+
+// Function to check whether a token is an annotation written before a
+// function or foreign declaration.
+bool is_function_annotation(TokenKind token_kind);
+
+// Function to check whether a token names a vector type.
+bool is_vector_type(TokenKind token_kind);
+
+// Function to obtain the integer type of the lanes of a vector type.
+TokenKind vector_element_type(TokenKind token_kind);
+
+// Function to obtain the number of lanes of a vector type.
+unsigned vector_lane_count(TokenKind token_kind);
+
+// Function to obtain the name of a vector type as written in FerroLang.
+const char *vector_type_name(TokenKind token_kind);
+
+// Function to find the length of an identifier or string literal again
+// from its first character.
+size_t lexer_token_length(TokenKind token_kind, const char *start);
+
 // Function to get the next token.
 Token compute_next_token(Lexer *lexer);
 
@@ -0,0 +1,17 @@
+#ifndef FERRO_LANG_LTO
+#define FERRO_LANG_LTO
+
+#include "llvm-c/Core.h"
+#include <stddef.h>
+
+// Function to link bitcode files, such as the standard library compiled
+// with `clang -emit-llvm`, into the program's module.
+void link_bitcode_files(LLVMModuleRef llvm_module, const char *const *paths,
+                        size_t path_count);
+
+// Function to give every definition except `main` internal linkage, so
+// the optimizer may inline, specialise or drop it. Only valid once the
+// module holds the whole program.
+void internalize_module(LLVMModuleRef llvm_module);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef FERRO_LANG_OPTIMIZER
+#define FERRO_LANG_OPTIMIZER
+
+#include "llvm-c/Core.h"
+#include "llvm-c/TargetMachine.h"
+#include <stdbool.h>
+
+// Options selecting the optimization pipeline.
+typedef struct {
+  unsigned level;   // 0 to 3, same meaning as clang's -O flags.
+  bool time_passes; // Print the time spent in every pass to stderr.
+} OptimizerOptions;
+
+// Function to run the new pass manager pipeline over a module.
+// The target machine may be NULL, which disables target specific tuning.
+void optimize_module(LLVMModuleRef llvm_module,
+                     LLVMTargetMachineRef target_machine,
+                     const OptimizerOptions *options);
+
+// Function to optimize a module linked from parts which were optimized on
+// their own, so calls between the parts are inlined and simplified.
+void optimize_linked_module(LLVMModuleRef llvm_module,
+                            LLVMTargetMachineRef target_machine,
+                            const OptimizerOptions *options);
+
+// Function to run the link-time pipeline over a module holding the whole
+// program, after its parts were optimized on their own and linked.
+// Functions which are not called from outside should be internal first.
+void optimize_module_lto(LLVMModuleRef llvm_module,
+                         LLVMTargetMachineRef target_machine,
+                         const OptimizerOptions *options);
+
+#endif
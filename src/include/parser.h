@@ -2,19 +2,37 @@
 #define FERRO_LANG_PARSER
 
 #include "ast.h"
+#include "helpers.h"
 #include "lexer.h"
+#include "tokens.h"
 
 // Parser defination
+// Tokens are read from the token buffer of the tree. The buffer is either
+// filled up front, or filled from the lexer as the parser reaches the end.
 typedef struct {
-  Lexer *lexer;
-  Token current_token;
-  Token previous_token;
+  Lexer *lexer; // NULL when the token buffer was filled up front.
+  Ast *ast;     // Receives the nodes built by the parser.
+  TokenIndex current_token;
+
+  // Children of the lists being parsed, copied to Ast.extra once complete.
+  Vector(uint32_t) scratch;
 } Parser;
 
-// Initalise the parser.
-void parser_init(Parser *parser, Lexer *lexer);
+// Initalise the parser, lexing on demand.
+void parser_init(Parser *parser, Lexer *lexer, Ast *ast);
+
+// Initalise the parser to read from the already filled token buffer of the
+// tree.
+void parser_init_tokens(Parser *parser, Ast *ast);
+
+// Release the parser's scratch space, the tree is left untouched.
+void parser_free(Parser *parser);
+
+// Look at the kind of a token ahead without consuming anything.
+// A distance of 0 is the current token.
+TokenKind parser_peek_kind(Parser *parser, size_t distance);
 
-// Generate a translation unit.
-AstNode *parse_translation_unit(Parser *parser);
+// Generate the translation unit, node 0 of the tree.
+void parse_translation_unit(Parser *parser);
 
-#endif
\ No newline at end of file
+#endif
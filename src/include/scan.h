@@ -0,0 +1,20 @@
+#ifndef FERRO_LANG_SCAN
+#define FERRO_LANG_SCAN
+
+// Vectorised byte scanning kernels used by the lexer.
+//
+// The kernels read whole 16 or 32 byte blocks aligned to their size, which
+// may extend past the null terminator of the source but never past the page
+// holding it. The scalar fallback is used when no vector unit is available.
+
+// Function to find the first '\n' or '\0' at or after the pointer.
+const char *scan_line_end(const char *ptr);
+
+// Function to find the first '"', '\\', '\n' or '\0' at or after the pointer.
+const char *scan_string_special(const char *ptr);
+
+// Function to find the first byte which is not ' ', '\t' or '\r' at or after
+// the pointer.
+const char *scan_blanks_end(const char *ptr);
+
+#endif
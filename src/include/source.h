@@ -0,0 +1,21 @@
+#ifndef FERRO_LANG_SOURCE
+#define FERRO_LANG_SOURCE
+
+#include <stddef.h>
+
+// Source File Defination
+// A read-only view of a file, always followed by a null terminator.
+typedef struct {
+  const char *path;
+  const char *contents;
+  size_t size;        // Bytes of the file, excluding the terminator.
+  size_t mapped_size; // Bytes of the mapping, zero when nothing is mapped.
+} SourceFile;
+
+// Function to map a source file into memory.
+void source_open(SourceFile *source, const char *path);
+
+// Function to release the mapping of a source file.
+void source_close(SourceFile *source);
+
+#endif
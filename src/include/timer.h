@@ -0,0 +1,65 @@
+#ifndef FERRO_LANG_TIMER
+#define FERRO_LANG_TIMER
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define TIME_REPORT_MAX_PHASES 16
+#define TIME_REPORT_MAX_COUNTERS 16
+
+// Possible formats of the time report.
+typedef enum {
+  TIME_REPORT_NONE,
+  TIME_REPORT_TABLE, // Human-readable table.
+  TIME_REPORT_JSON,  // Single line of JSON, for tracking regressions.
+} TimeReportFormat;
+
+// Time spent in one compiler phase, summed over every time it ran.
+typedef struct {
+  const char *name;
+  double wall_seconds;
+  double cpu_seconds;
+  size_t peak_rss_bytes; // Peak resident set size when the phase ended.
+} PhaseTiming;
+
+// A named quantity reported next to the timings.
+typedef struct {
+  const char *name;
+  size_t value;
+} ReportCounter;
+
+// Time Report Defination
+// Collects per-phase timings and counters of a single compiler run.
+typedef struct {
+  PhaseTiming phases[TIME_REPORT_MAX_PHASES];
+  size_t phase_count;
+  ReportCounter counters[TIME_REPORT_MAX_COUNTERS];
+  size_t counter_count;
+
+  // The phase currently being measured.
+  PhaseTiming *current;
+  double current_wall_start;
+  double current_cpu_start;
+} TimeReport;
+
+// Function to initialise the time report.
+void time_report_init(TimeReport *report);
+
+// Function to start measuring a phase.
+// A NULL report measures nothing, for code which is only sometimes timed.
+void time_report_begin(TimeReport *report, const char *phase);
+
+// Function to stop measuring the current phase.
+void time_report_end(TimeReport *report);
+
+// Function to record a counter, replacing an earlier value of the same name.
+void time_report_counter(TimeReport *report, const char *name, size_t value);
+
+// Function to print the report as a human-readable table.
+void time_report_print(const TimeReport *report, FILE *stream);
+
+// Function to print the report as JSON.
+void time_report_print_json(const TimeReport *report, FILE *stream);
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef FERRO_LANG_TOKENS
+#define FERRO_LANG_TOKENS
+
+#include "intern.h"
+#include "lexer.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Token Buffer Defination
+// Every token of a source file, lexed up front and stored as a struct of
+// arrays. A token takes 9 bytes instead of the 32 of a Token, and the
+// parser can look any number of tokens ahead.
+// Lines are not stored per token, they are found from the offset in a table
+// of line starts, narrowed by the line of every 64th token. The length of
+// names and string literals is found again by lexing their text, every other
+// token keeps it in place of an InternId.
+typedef struct {
+  const char *source; // Start of the source the offsets are relative to.
+
+  uint8_t *kinds;       // TokenKind of every token.
+  uint32_t *offsets;    // Byte offset of the first character.
+  InternId *intern_ids; // Identifier name or unescaped string literal value,
+                        // the length in bytes of any other token.
+
+  size_t count;
+  size_t capacity;
+
+  uint32_t *line_starts; // Byte offset of the first character of each line.
+  size_t line_count;
+  uint32_t *line_checkpoints; // Line index of every 64th token.
+} TokenBuffer;
+
+// Function to initialise the token buffer, reserving space for a source of
+// the given size.
+void token_buffer_init(TokenBuffer *buffer, const char *source,
+                       size_t source_size);
+
+// Function to append a token.
+void token_buffer_push(TokenBuffer *buffer, Token token);
+
+// Function to lex the remaining source up to and including TOKEN_EOF.
+void token_buffer_fill(TokenBuffer *buffer, Lexer *lexer);
+
+// Function to check whether a token keeps an InternId, rather than its
+// length, in the buffer.
+static inline bool token_has_intern_id(TokenKind kind) {
+  return kind == TOKEN_IDENTIFIER || kind == TOKEN_STRING_LITERAL;
+}
+
+// Function to obtain the line of the token at an index.
+size_t token_buffer_line(const TokenBuffer *buffer, size_t index);
+
+// Function to rebuild the token at an index.
+// Indices past the end yield the final TOKEN_EOF.
+Token token_buffer_get(const TokenBuffer *buffer, size_t index);
+
+// Function to obtain the bytes held by the arrays of the buffer, counting
+// either the tokens in use or every reserved slot.
+size_t token_buffer_bytes(const TokenBuffer *buffer, bool reserved);
+
+// Function to release the arrays of the token buffer.
+void token_buffer_free(TokenBuffer *buffer);
+
+#endif
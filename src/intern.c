@@ -0,0 +1,144 @@
+#include "include/intern.h"
+#include "include/arena.h"
+#include "include/helpers.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Global pool shared by the lexer, parser and codegen.
+static InternPool intern_pool;
+
+// Pool the calling thread interns into instead of the global one, if any.
+static _Thread_local InternPool *intern_local_pool;
+
+// Function to initialise an empty intern pool.
+void intern_pool_init(InternPool *pool) {
+  arena_init(&pool->bytes);
+  vec_init(InternString, &pool->strings);
+  pool->slots = NULL;
+  pool->capacity = 0;
+
+  // Reserving the identifier zero for INTERN_NONE.
+  vec_push(InternString, &pool->strings,
+           ((InternString){.data = "", .length = 0, .hash = 0}));
+}
+
+// Function to release an intern pool.
+void intern_pool_free(InternPool *pool) {
+  arena_free(&pool->bytes);
+  vec_free(InternString, &pool->strings);
+  free(pool->slots);
+  pool->slots = NULL;
+  pool->capacity = 0;
+}
+
+// Function to initialise the global intern pool.
+void intern_init(void) { intern_pool_init(&intern_pool); }
+
+// Function to release the global intern pool.
+void intern_free(void) { intern_pool_free(&intern_pool); }
+
+// Helper function to locate the slot for a byte slice.
+static InternId *intern_slot(const InternPool *pool, InternId *slots,
+                             size_t capacity, const char *data, size_t length,
+                             uint64_t hash) {
+  size_t mask = capacity - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    InternId id = slots[i];
+    if (id == INTERN_NONE) {
+      return &slots[i];
+    }
+
+    const InternString *string = &pool->strings.data[id];
+    if (string->hash == hash && string->length == length &&
+        memcmp(string->data, data, length) == 0) {
+      return &slots[i];
+    }
+  }
+}
+
+// Helper function to grow the table, keeping it at most half full.
+static void intern_grow(InternPool *pool) {
+  size_t capacity = pool->capacity == 0 ? 1024 : pool->capacity * 2;
+  InternId *slots = calloc(capacity, sizeof(InternId));
+  if (!slots) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(1);
+  }
+
+  for (size_t id = 1; id < pool->strings.length; id++) {
+    const InternString *string = &pool->strings.data[id];
+    *intern_slot(pool, slots, capacity, string->data, string->length,
+                 string->hash) = (InternId)id;
+  }
+
+  free(pool->slots);
+  pool->slots = slots;
+  pool->capacity = capacity;
+}
+
+// Helper function to intern a byte slice whose hash is known.
+static InternId intern_hashed(InternPool *pool, const char *data,
+                              size_t length, uint64_t hash) {
+  if (pool->strings.length * 2 > pool->capacity) {
+    intern_grow(pool);
+  }
+
+  InternId *slot =
+      intern_slot(pool, pool->slots, pool->capacity, data, length, hash);
+  if (*slot != INTERN_NONE) {
+    return *slot;
+  }
+
+  // Copying the bytes into the pool, so they outlive the source buffer.
+  char *copy = arena_alloc(&pool->bytes, length + 1);
+  memcpy(copy, data, length);
+  copy[length] = '\0';
+
+  InternId id = (InternId)pool->strings.length;
+  vec_push(InternString, &pool->strings,
+           ((InternString){.data = copy, .length = length, .hash = hash}));
+  *slot = id;
+  return id;
+}
+
+// Function to intern a byte slice, returning its identifier.
+InternId intern(const char *data, size_t length) {
+  InternPool *pool = intern_local_pool ? intern_local_pool : &intern_pool;
+  return intern_hashed(pool, data, length, hash_bytes(data, length));
+}
+
+// Function to make the calling thread intern into its own pool.
+void intern_begin_local(InternPool *pool) { intern_local_pool = pool; }
+
+// Function to make the calling thread intern into the global pool again.
+void intern_end_local(void) { intern_local_pool = NULL; }
+
+// Function to move a string of a local pool into the global pool, returning
+// its identifier there.
+InternId intern_merge(const InternPool *pool, InternId id) {
+  if (id == INTERN_NONE) {
+    return INTERN_NONE;
+  }
+
+  const InternString *string = &pool->strings.data[id];
+  return intern_hashed(&intern_pool, string->data, string->length,
+                       string->hash);
+}
+
+// Function to obtain the number of distinct interned strings.
+size_t intern_count(void) { return intern_pool.strings.length - 1; }
+
+// Function to obtain the interned string for an identifier.
+const InternString *intern_get(InternId id) {
+  return &intern_pool.strings.data[id];
+}
+
+// Function to print the memory held by the global intern pool.
+void intern_print_stats(FILE *stream) {
+  fprintf(stream,
+          "intern: %zu strings, %zu bytes requested, %zu bytes reserved in "
+          "%zu chunks\n",
+          intern_count(), intern_pool.bytes.bytes_requested,
+          intern_pool.bytes.peak_bytes, intern_pool.bytes.chunk_count);
+}
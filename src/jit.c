@@ -0,0 +1,86 @@
+#include "include/emit.h"
+#include "include/jit.h"
+#include "llvm-c/Core.h"
+#include "llvm-c/Error.h"
+#include "llvm-c/LLJIT.h"
+#include "llvm-c/Orc.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Helper function to report an LLVM error and exit.
+void exit_on_jit_error(LLVMErrorRef error, const char *action) {
+  if (!error) {
+    return;
+  }
+
+  char *message = LLVMGetErrorMessage(error);
+  fprintf(stderr, "Failed to %s: %s\n", action, message);
+  LLVMDisposeErrorMessage(message);
+  exit(1);
+}
+
+// Function to JIT compile a module in-process and call its `main`.
+// The module must belong to the thread safe context, the JIT takes
+// ownership of it. Returns the value returned by `main`.
+int jit_run_main(LLVMModuleRef llvm_module,
+                 LLVMOrcThreadSafeContextRef thread_safe_context) {
+  initialise_native_target();
+
+  // Remembering how `main` returns before the module is handed over.
+  LLVMValueRef main_fn = LLVMGetNamedFunction(llvm_module, "main");
+  if (!main_fn) {
+    fprintf(stderr, "Error: The program does not define a main function.\n");
+    exit(1);
+  }
+  LLVMTypeRef return_type = LLVMGetReturnType(LLVMGlobalGetValueType(main_fn));
+  unsigned return_width = LLVMGetTypeKind(return_type) == LLVMIntegerTypeKind
+                              ? LLVMGetIntTypeWidth(return_type)
+                              : 0;
+
+  LLVMOrcLLJITRef jit = NULL;
+  exit_on_jit_error(LLVMOrcCreateLLJIT(&jit, NULL), "create the JIT");
+
+  // `@foreign` symbols such as printf resolve against the host process.
+  LLVMOrcJITDylibRef main_dylib = LLVMOrcLLJITGetMainJITDylib(jit);
+  LLVMOrcDefinitionGeneratorRef process_symbols = NULL;
+  exit_on_jit_error(LLVMOrcCreateDynamicLibrarySearchGeneratorForProcess(
+                        &process_symbols, LLVMOrcLLJITGetGlobalPrefix(jit),
+                        NULL, NULL),
+                    "expose the host process symbols");
+  LLVMOrcJITDylibAddGenerator(main_dylib, process_symbols);
+
+  LLVMOrcThreadSafeModuleRef thread_safe_module =
+      LLVMOrcCreateNewThreadSafeModule(llvm_module, thread_safe_context);
+  exit_on_jit_error(
+      LLVMOrcLLJITAddLLVMIRModule(jit, main_dylib, thread_safe_module),
+      "add the module to the JIT");
+
+  LLVMOrcExecutorAddress main_address = 0;
+  exit_on_jit_error(LLVMOrcLLJITLookup(jit, &main_address, "main"),
+                    "look up main");
+
+  // Calling `main` through a pointer matching its return width.
+  int result = 0;
+  switch (return_width) {
+  case 0:
+    ((void (*)(void))main_address)();
+    break;
+  case 8:
+    result = ((int8_t(*)(void))main_address)();
+    break;
+  case 16:
+    result = ((int16_t(*)(void))main_address)();
+    break;
+  case 32:
+    result = ((int32_t(*)(void))main_address)();
+    break;
+  default:
+    result = (int)((int64_t(*)(void))main_address)();
+    break;
+  }
+
+  fflush(stdout);
+  exit_on_jit_error(LLVMOrcDisposeLLJIT(jit), "tear down the JIT");
+  return result;
+}
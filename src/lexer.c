@@ -1,19 +1,28 @@
 #include "include/lexer.h"
-#include <ctype.h>
+#include "include/scan.h"
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 
-typedef struct {
-  const char *name;
-  TokenKind kind;
-} SpecialWord;
-
-SpecialWord special_words[] = {{"int", TOKEN_INT},
-                               {"return", TOKEN_RETURN},
-                               {"String", TOKEN_STRING},
-                               {"@foreign", TOKEN_FOREIGN},
-                               {"void", TOKEN_VOID}};
+// Character classes, looked up through character_classes instead of the
+// locale dependent <ctype.h> functions.
+enum {
+  CHAR_DIGIT = 1 << 0,
+  CHAR_IDENTIFIER_START = 1 << 1, // Letters and '_'.
+  CHAR_IDENTIFIER = 1 << 2,       // Letters, digits and '_'.
+};
+
+static const unsigned char character_classes[256] = {
+    ['0' ... '9'] = CHAR_DIGIT | CHAR_IDENTIFIER,
+    ['a' ... 'z'] = CHAR_IDENTIFIER_START | CHAR_IDENTIFIER,
+    ['A' ... 'Z'] = CHAR_IDENTIFIER_START | CHAR_IDENTIFIER,
+    ['_'] = CHAR_IDENTIFIER_START | CHAR_IDENTIFIER,
+};
+
+// Helper function to check the class of a character.
+static inline bool is_character_class(char character, unsigned char classes) {
+  return (character_classes[(unsigned char)character] & classes) != 0;
+}
 
 // Function to intialise the lexer.
 void lexer_init(Lexer *lexer, const char *source_code) {
@@ -35,12 +44,94 @@ const char *token_kind_to_string(TokenKind token_kind) {
     return "TOKEN_INT";
   case TOKEN_STRING:
     return "TOKEN_STRING";
+  case TOKEN_BOOL:
+    return "TOKEN_BOOL";
+  case TOKEN_I8:
+    return "TOKEN_I8";
+  case TOKEN_I16:
+    return "TOKEN_I16";
+  case TOKEN_I32:
+    return "TOKEN_I32";
+  case TOKEN_I64:
+    return "TOKEN_I64";
+  case TOKEN_U8:
+    return "TOKEN_U8";
+  case TOKEN_U16:
+    return "TOKEN_U16";
+  case TOKEN_U32:
+    return "TOKEN_U32";
+  case TOKEN_U64:
+    return "TOKEN_U64";
+  case TOKEN_I8X16:
+    return "TOKEN_I8X16";
+  case TOKEN_I16X8:
+    return "TOKEN_I16X8";
+  case TOKEN_I32X4:
+    return "TOKEN_I32X4";
+  case TOKEN_I64X2:
+    return "TOKEN_I64X2";
+  case TOKEN_U8X16:
+    return "TOKEN_U8X16";
+  case TOKEN_U16X8:
+    return "TOKEN_U16X8";
+  case TOKEN_U32X4:
+    return "TOKEN_U32X4";
+  case TOKEN_U64X2:
+    return "TOKEN_U64X2";
+  case TOKEN_I8X32:
+    return "TOKEN_I8X32";
+  case TOKEN_I16X16:
+    return "TOKEN_I16X16";
+  case TOKEN_I32X8:
+    return "TOKEN_I32X8";
+  case TOKEN_I64X4:
+    return "TOKEN_I64X4";
+  case TOKEN_U8X32:
+    return "TOKEN_U8X32";
+  case TOKEN_U16X16:
+    return "TOKEN_U16X16";
+  case TOKEN_U32X8:
+    return "TOKEN_U32X8";
+  case TOKEN_U64X4:
+    return "TOKEN_U64X4";
   case TOKEN_FOREIGN:
     return "TOKEN_FOREIGN";
+  case TOKEN_SIZED:
+    return "TOKEN_SIZED";
+  case TOKEN_NOALIAS:
+    return "TOKEN_NOALIAS";
+  case TOKEN_INLINE:
+    return "TOKEN_INLINE";
+  case TOKEN_NOINLINE:
+    return "TOKEN_NOINLINE";
+  case TOKEN_PURE:
+    return "TOKEN_PURE";
+  case TOKEN_COLD:
+    return "TOKEN_COLD";
+  case TOKEN_NOUNWIND:
+    return "TOKEN_NOUNWIND";
   case TOKEN_STRING_LITERAL:
     return "TOKEN_STRING_LITERAL";
   case TOKEN_RETURN:
     return "TOKEN_RETURN";
+  case TOKEN_TRUE:
+    return "TOKEN_TRUE";
+  case TOKEN_FALSE:
+    return "TOKEN_FALSE";
+  case TOKEN_LET:
+    return "TOKEN_LET";
+  case TOKEN_IF:
+    return "TOKEN_IF";
+  case TOKEN_ELSE:
+    return "TOKEN_ELSE";
+  case TOKEN_WHILE:
+    return "TOKEN_WHILE";
+  case TOKEN_FOR:
+    return "TOKEN_FOR";
+  case TOKEN_BREAK:
+    return "TOKEN_BREAK";
+  case TOKEN_CONTINUE:
+    return "TOKEN_CONTINUE";
   case TOKEN_INT_LITERAL:
     return "TOKEN_INT_LITERAL";
   case TOKEN_LPAREN:
@@ -51,12 +142,60 @@ const char *token_kind_to_string(TokenKind token_kind) {
     return "TOKEN_LBRACE";
   case TOKEN_RBRACE:
     return "TOKEN_RBRACE";
+  case TOKEN_LBRACKET:
+    return "TOKEN_LBRACKET";
+  case TOKEN_RBRACKET:
+    return "TOKEN_RBRACKET";
+  case TOKEN_COLON:
+    return "TOKEN_COLON";
   case TOKEN_SEMICOLON:
     return "TOKEN_SEMICOLON";
   case TOKEN_COMMA:
     return "TOKEN_COMMA";
   case TOKEN_IDENTIFIER:
     return "TOKEN_IDENTIFIER";
+  case TOKEN_PLUS:
+    return "TOKEN_PLUS";
+  case TOKEN_MINUS:
+    return "TOKEN_MINUS";
+  case TOKEN_STAR:
+    return "TOKEN_STAR";
+  case TOKEN_SLASH:
+    return "TOKEN_SLASH";
+  case TOKEN_PERCENT:
+    return "TOKEN_PERCENT";
+  case TOKEN_AMPERSAND:
+    return "TOKEN_AMPERSAND";
+  case TOKEN_PIPE:
+    return "TOKEN_PIPE";
+  case TOKEN_CARET:
+    return "TOKEN_CARET";
+  case TOKEN_TILDE:
+    return "TOKEN_TILDE";
+  case TOKEN_BANG:
+    return "TOKEN_BANG";
+  case TOKEN_SHIFT_LEFT:
+    return "TOKEN_SHIFT_LEFT";
+  case TOKEN_SHIFT_RIGHT:
+    return "TOKEN_SHIFT_RIGHT";
+  case TOKEN_AND_AND:
+    return "TOKEN_AND_AND";
+  case TOKEN_OR_OR:
+    return "TOKEN_OR_OR";
+  case TOKEN_EQUAL_EQUAL:
+    return "TOKEN_EQUAL_EQUAL";
+  case TOKEN_BANG_EQUAL:
+    return "TOKEN_BANG_EQUAL";
+  case TOKEN_LESS:
+    return "TOKEN_LESS";
+  case TOKEN_LESS_EQUAL:
+    return "TOKEN_LESS_EQUAL";
+  case TOKEN_GREATER:
+    return "TOKEN_GREATER";
+  case TOKEN_GREATER_EQUAL:
+    return "TOKEN_GREATER_EQUAL";
+  case TOKEN_EQUAL:
+    return "TOKEN_EQUAL";
   case TOKEN_EOF:
     return "TOKEN_EOF";
   }
@@ -64,6 +203,145 @@ const char *token_kind_to_string(TokenKind token_kind) {
   return "TOKEN_?";
 }
 
+// Function to check whether a token names an integer type.
+bool is_integer_type(TokenKind token_kind) {
+  switch (token_kind) {
+  case TOKEN_INT:
+  case TOKEN_I8:
+  case TOKEN_I16:
+  case TOKEN_I32:
+  case TOKEN_I64:
+  case TOKEN_U8:
+  case TOKEN_U16:
+  case TOKEN_U32:
+  case TOKEN_U64:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Function to check whether a token is an annotation written before a
+// function or foreign declaration.
+bool is_function_annotation(TokenKind token_kind) {
+  switch (token_kind) {
+  case TOKEN_INLINE:
+  case TOKEN_NOINLINE:
+  case TOKEN_PURE:
+  case TOKEN_COLD:
+  case TOKEN_NOUNWIND:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Vector Type Defination
+// The spelling and lanes of every vector type, in the order of their tokens.
+typedef struct {
+  const char *name;
+  TokenKind element_type;
+  unsigned lane_count;
+} VectorType;
+
+static const VectorType vector_types[] = {
+    {"i8x16", TOKEN_I8, 16},
+    {"i16x8", TOKEN_I16, 8},
+    {"i32x4", TOKEN_I32, 4},
+    {"i64x2", TOKEN_I64, 2},
+    {"u8x16", TOKEN_U8, 16},
+    {"u16x8", TOKEN_U16, 8},
+    {"u32x4", TOKEN_U32, 4},
+    {"u64x2", TOKEN_U64, 2},
+    {"i8x32", TOKEN_I8, 32},
+    {"i16x16", TOKEN_I16, 16},
+    {"i32x8", TOKEN_I32, 8},
+    {"i64x4", TOKEN_I64, 4},
+    {"u8x32", TOKEN_U8, 32},
+    {"u16x16", TOKEN_U16, 16},
+    {"u32x8", TOKEN_U32, 8},
+    {"u64x4", TOKEN_U64, 4},
+};
+
+// Function to check whether a token names a vector type.
+bool is_vector_type(TokenKind token_kind) {
+  return token_kind >= TOKEN_I8X16 && token_kind <= TOKEN_U64X4;
+}
+
+// Function to obtain the integer type of the lanes of a vector type.
+TokenKind vector_element_type(TokenKind token_kind) {
+  return vector_types[token_kind - TOKEN_I8X16].element_type;
+}
+
+// Function to obtain the number of lanes of a vector type.
+unsigned vector_lane_count(TokenKind token_kind) {
+  return vector_types[token_kind - TOKEN_I8X16].lane_count;
+}
+
+// Function to obtain the name of a vector type as written in FerroLang.
+const char *vector_type_name(TokenKind token_kind) {
+  return vector_types[token_kind - TOKEN_I8X16].name;
+}
+
+// Helper function to read a number of one or two digits without a leading
+// zero, returning zero for anything else.
+static unsigned read_small_number(const char *digits, size_t length) {
+  if (length == 0 || length > 2 || digits[0] < '1' || digits[0] > '9') {
+    return 0;
+  }
+  if (length == 1) {
+    return (unsigned)(digits[0] - '0');
+  }
+  if (digits[1] < '0' || digits[1] > '9') {
+    return 0;
+  }
+  return (unsigned)(digits[0] - '0') * 10 + (unsigned)(digits[1] - '0');
+}
+
+// Helper function to check if a word names a vector type, an integer type
+// followed by 'x' and the number of lanes. The name is decoded instead of
+// being compared against every vector type: the tokens are ordered by size,
+// then signedness, then element width, see vector_types.
+TokenKind match_vector_type(const char *word, size_t token_length) {
+  bool is_signed = word[0] == 'i';
+  if (!is_signed && word[0] != 'u') {
+    return TOKEN_IDENTIFIER;
+  }
+
+  size_t x = word[2] == 'x' ? 2 : word[3] == 'x' ? 3 : 0;
+  if (x == 0) {
+    return TOKEN_IDENTIFIER;
+  }
+  unsigned width = read_small_number(word + 1, x - 1);
+  unsigned lane_count =
+      read_small_number(word + x + 1, token_length - x - 1);
+
+  unsigned width_index;
+  switch (width) {
+  case 8:
+    width_index = 0;
+    break;
+  case 16:
+    width_index = 1;
+    break;
+  case 32:
+    width_index = 2;
+    break;
+  case 64:
+    width_index = 3;
+    break;
+  default:
+    return TOKEN_IDENTIFIER;
+  }
+
+  unsigned bits = width * lane_count;
+  if (bits != 128 && bits != 256) {
+    return TOKEN_IDENTIFIER;
+  }
+  return (TokenKind)(TOKEN_I8X16 + (bits == 256 ? 8 : 0) +
+                     (is_signed ? 0 : 4) + width_index);
+}
+
 // Helper function to obtain the current character.
 char peek(Lexer *lexer) {
   // Returning the the current character.
@@ -77,6 +355,17 @@ char advance(Lexer *lexer) {
   return previous_character;
 }
 
+// Helper function to advance the lexer only if the current character is the
+// expected one.
+bool match_character(Lexer *lexer, char expected) {
+  if (peek(lexer) != expected) {
+    return false;
+  }
+
+  advance(lexer);
+  return true;
+}
+
 // Helper function to skip over whitepaces and comments.
 void skip_whitespaces_and_comments(Lexer *lexer) {
   // Running the loop indefinately intentionally.
@@ -85,10 +374,13 @@ void skip_whitespaces_and_comments(Lexer *lexer) {
     switch (peek(lexer)) {
     case ' ':
     case '\r':
-    case '\t':
-      advance(lexer);
-      lexer->column++;
+    case '\t': {
+      // Skipping the whole run of blanks at once.
+      const char *end = scan_blanks_end(lexer->current_ptr);
+      lexer->column += (size_t)(end - lexer->current_ptr);
+      lexer->current_ptr = end;
       break;
+    }
 
     case '\n':
       advance(lexer);
@@ -96,12 +388,13 @@ void skip_whitespaces_and_comments(Lexer *lexer) {
       lexer->column = 0;
       break;
 
-    case '#':
-      do {
-        advance(lexer);
-        lexer->column++;
-      } while (peek(lexer) != '\n' && peek(lexer) != '\0');
+    case '#': {
+      // Skipping to the end of the line, the newline itself is handled above.
+      const char *end = scan_line_end(lexer->current_ptr);
+      lexer->column += (size_t)(end - lexer->current_ptr);
+      lexer->current_ptr = end;
       break;
+    }
 
     default:
       // If the program execution reaches here,
@@ -124,31 +417,193 @@ Token make_token(Lexer *lexer, TokenKind token_kind) {
   return token;
 }
 
-// Helper function to check if the identifier is a special word.
+// Helper function to check if the identifier is a keyword.
+// Keywords are told apart by their length and first character, so at most
+// one comparison is made however many keywords there are.
 TokenKind is_special_word(const char *word, size_t token_length) {
-  for (size_t i = 0; i < sizeof(special_words) / sizeof(SpecialWord); i++) {
-    if (strlen(special_words[i].name) == token_length &&
-        strncmp(word, special_words[i].name, token_length) == 0) {
-      return special_words[i].kind;
+  switch (token_length) {
+  case 2:
+    if (word[1] == '8' && (word[0] == 'i' || word[0] == 'u')) {
+      return word[0] == 'i' ? TOKEN_I8 : TOKEN_U8;
+    }
+    if (word[0] == 'i' && word[1] == 'f') {
+      return TOKEN_IF;
+    }
+    break;
+
+  case 3:
+    // Sized integers, a sign letter followed by the width.
+    if (word[0] == 'i' || word[0] == 'u') {
+      bool is_signed = word[0] == 'i';
+      if (word[1] == '1' && word[2] == '6') {
+        return is_signed ? TOKEN_I16 : TOKEN_U16;
+      }
+      if (word[1] == '3' && word[2] == '2') {
+        return is_signed ? TOKEN_I32 : TOKEN_U32;
+      }
+      if (word[1] == '6' && word[2] == '4') {
+        return is_signed ? TOKEN_I64 : TOKEN_U64;
+      }
+    }
+    switch (word[0]) {
+    case 'i':
+      if (memcmp(word, "int", 3) == 0) {
+        return TOKEN_INT;
+      }
+      break;
+    case 'l':
+      if (memcmp(word, "let", 3) == 0) {
+        return TOKEN_LET;
+      }
+      break;
+    case 'f':
+      if (memcmp(word, "for", 3) == 0) {
+        return TOKEN_FOR;
+      }
+      break;
     }
+    break;
+
+  case 4:
+    switch (word[0]) {
+    case 'v':
+      if (memcmp(word, "void", 4) == 0) {
+        return TOKEN_VOID;
+      }
+      break;
+    case 'b':
+      if (memcmp(word, "bool", 4) == 0) {
+        return TOKEN_BOOL;
+      }
+      break;
+    case 't':
+      if (memcmp(word, "true", 4) == 0) {
+        return TOKEN_TRUE;
+      }
+      break;
+    case 'e':
+      if (memcmp(word, "else", 4) == 0) {
+        return TOKEN_ELSE;
+      }
+      break;
+    }
+    break;
+
+  case 5:
+    if (word[2] == 'x' || word[3] == 'x') {
+      TokenKind vector_type = match_vector_type(word, token_length);
+      if (vector_type != TOKEN_IDENTIFIER) {
+        return vector_type;
+      }
+    }
+    switch (word[0]) {
+    case 'f':
+      if (memcmp(word, "false", 5) == 0) {
+        return TOKEN_FALSE;
+      }
+      break;
+    case 'w':
+      if (memcmp(word, "while", 5) == 0) {
+        return TOKEN_WHILE;
+      }
+      break;
+    case 'b':
+      if (memcmp(word, "break", 5) == 0) {
+        return TOKEN_BREAK;
+      }
+      break;
+    }
+    break;
+
+  case 6:
+    if (word[3] == 'x') {
+      TokenKind vector_type = match_vector_type(word, token_length);
+      if (vector_type != TOKEN_IDENTIFIER) {
+        return vector_type;
+      }
+    }
+    switch (word[0]) {
+    case 'r':
+      if (memcmp(word, "return", 6) == 0) {
+        return TOKEN_RETURN;
+      }
+      break;
+    case 'S':
+      if (memcmp(word, "String", 6) == 0) {
+        return TOKEN_STRING;
+      }
+      break;
+    }
+    break;
+
+  case 8:
+    if (word[0] == 'c' && memcmp(word, "continue", 8) == 0) {
+      return TOKEN_CONTINUE;
+    }
+    break;
+  }
+
+  return TOKEN_IDENTIFIER;
+}
+
+// Helper function to check if the word after '@' is an annotation.
+TokenKind is_annotation(const char *word, size_t token_length) {
+  switch (token_length) {
+  case 5:
+    if (memcmp(word, "@pure", 5) == 0) {
+      return TOKEN_PURE;
+    }
+    if (memcmp(word, "@cold", 5) == 0) {
+      return TOKEN_COLD;
+    }
+    break;
+  case 6:
+    if (memcmp(word, "@sized", 6) == 0) {
+      return TOKEN_SIZED;
+    }
+    break;
+  case 7:
+    if (memcmp(word, "@inline", 7) == 0) {
+      return TOKEN_INLINE;
+    }
+    break;
+  case 8:
+    if (memcmp(word, "@foreign", 8) == 0) {
+      return TOKEN_FOREIGN;
+    }
+    if (memcmp(word, "@noalias", 8) == 0) {
+      return TOKEN_NOALIAS;
+    }
+    break;
+  case 9:
+    if (memcmp(word, "@noinline", 9) == 0) {
+      return TOKEN_NOINLINE;
+    }
+    if (memcmp(word, "@nounwind", 9) == 0) {
+      return TOKEN_NOUNWIND;
+    }
+    break;
   }
 
   return TOKEN_IDENTIFIER;
 }
 
+// Helper function to advance the lexer until the end of a word.
+static inline void skip_identifier_characters(Lexer *lexer) {
+  while (is_character_class(peek(lexer), CHAR_IDENTIFIER)) {
+    advance(lexer);
+  }
+}
+
 // Helper function to make special word.
 Token make_special_word(Lexer *lexer) {
   // Advance the lexer until the end of word.
-  while (isalpha(peek(lexer)) || isdigit(peek(lexer)) || peek(lexer) == '_') {
-    advance(lexer);
-  }
+  skip_identifier_characters(lexer);
 
   size_t token_length = (size_t)(lexer->current_ptr - lexer->start_ptr);
-  for (size_t i = 0; i < sizeof(special_words) / sizeof(SpecialWord); i++) {
-    if (strlen(special_words[i].name) == token_length &&
-        strncmp(lexer->start_ptr, special_words[i].name, token_length) == 0) {
-      return make_token(lexer, special_words[i].kind);
-    }
+  TokenKind kind = is_annotation(lexer->start_ptr, token_length);
+  if (kind != TOKEN_IDENTIFIER) {
+    return make_token(lexer, kind);
   }
 
   // Error Message
@@ -160,32 +615,103 @@ Token make_special_word(Lexer *lexer) {
 // Helper function to generate identifiers.
 Token make_identifier_token(Lexer *lexer) {
   // Advance the lexer until the end of word.
-  while (isalpha(peek(lexer)) || isdigit(peek(lexer)) || peek(lexer) == '_') {
-    advance(lexer);
+  skip_identifier_characters(lexer);
+
+  size_t token_length = (size_t)(lexer->current_ptr - lexer->start_ptr);
+  Token token =
+      make_token(lexer, is_special_word(lexer->start_ptr, token_length));
+  if (token.kind == TOKEN_IDENTIFIER) {
+    token.intern_id = intern(lexer->start_ptr, token_length);
   }
 
-  return make_token(
-      lexer, is_special_word(lexer->start_ptr,
-                             (size_t)(lexer->current_ptr - lexer->start_ptr)));
+  return token;
 }
 
 // Helper function to generate numbers.
 Token make_number_token(Lexer *lexer) {
-  while (isdigit(peek(lexer))) {
+  while (is_character_class(peek(lexer), CHAR_DIGIT)) {
     advance(lexer);
   }
 
   return make_token(lexer, TOKEN_INT_LITERAL);
 }
 
+// Helper function to resolve the escape sequences of a string literal.
+// The result is never longer than the raw string.
+size_t process_escape_sequences(const char *raw_string, size_t length,
+                                char *processed) {
+  size_t write_pos = 0;
+  for (size_t read_pos = 0; read_pos < length; read_pos++) {
+    if (raw_string[read_pos] == '\\' && read_pos + 1 < length) {
+      // Process escape sequence
+      switch (raw_string[read_pos + 1]) {
+      case 'n':
+        processed[write_pos++] = '\n';
+        break;
+      case 't':
+        processed[write_pos++] = '\t';
+        break;
+      case 'r':
+        processed[write_pos++] = '\r';
+        break;
+      case '\\':
+        processed[write_pos++] = '\\';
+        break;
+      case '"':
+        processed[write_pos++] = '"';
+        break;
+      case '0':
+        processed[write_pos++] = '\0';
+        break;
+      default:
+        // If it's not a recognized escape sequence, keep both characters
+        processed[write_pos++] = raw_string[read_pos];
+        processed[write_pos++] = raw_string[read_pos + 1];
+        break;
+      }
+      read_pos++; // Skip the escaped character
+    } else {
+      processed[write_pos++] = raw_string[read_pos];
+    }
+  }
+
+  return write_pos;
+}
+
 Token make_string_token(Lexer *lexer) {
-  // Consume until closing quote or EOF
-  while (peek(lexer) != '"' && peek(lexer) != '\0') {
-    if (peek(lexer) == '\\') {
-      advance(lexer);
+  // Consume until closing quote or EOF, jumping between the bytes which need
+  // attention instead of looking at every byte.
+  size_t start_line = lexer->line;
+  bool has_escapes = false;
+  for (;;) {
+    const char *special = scan_string_special(lexer->current_ptr);
+    lexer->column += (size_t)(special - lexer->current_ptr);
+    lexer->current_ptr = special;
+
+    char character = peek(lexer);
+    if (character == '"' || character == '\0') {
+      break;
+    }
+
+    if (character == '\\') {
+      has_escapes = true;
       advance(lexer);
+      lexer->column++;
+
+      // A backslash right before the end of the source escapes nothing.
+      character = peek(lexer);
+      if (character == '\0') {
+        break;
+      }
+    }
+
+    // Keeping the line count right for multi-line strings.
+    advance(lexer);
+    if (character == '\n') {
+      lexer->line++;
+      lexer->column = 0;
     } else {
-      advance(lexer);
+      lexer->column++;
     }
   }
 
@@ -195,7 +721,49 @@ Token make_string_token(Lexer *lexer) {
   }
 
   advance(lexer);
-  return make_token(lexer, TOKEN_STRING_LITERAL);
+  Token token = make_token(lexer, TOKEN_STRING_LITERAL);
+  token.line = start_line;
+
+  // Interning the value without the surrounding quotes.
+  const char *raw = token.start_ptr + 1;
+  size_t raw_length = token.length - 2;
+  if (!has_escapes) {
+    token.intern_id = intern(raw, raw_length);
+    return token;
+  }
+
+  char *processed = malloc(raw_length);
+  if (!processed) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(1);
+  }
+  size_t processed_length =
+      process_escape_sequences(raw, raw_length, processed);
+  token.intern_id = intern(processed, processed_length);
+  free(processed);
+
+  return token;
+}
+
+// Function to find the length of an identifier or string literal again
+// from its first character.
+size_t lexer_token_length(TokenKind token_kind, const char *start) {
+  const char *ptr = start + 1;
+  if (token_kind == TOKEN_IDENTIFIER) {
+    while (is_character_class(*ptr, CHAR_IDENTIFIER)) {
+      ptr++;
+    }
+    return (size_t)(ptr - start);
+  }
+
+  // The lexer has already checked that the closing quote exists.
+  for (;;) {
+    ptr = scan_string_special(ptr);
+    if (*ptr == '"') {
+      return (size_t)(ptr + 1 - start);
+    }
+    ptr += *ptr == '\\' ? 2 : 1;
+  }
 }
 
 // Function to compute next token.
@@ -232,10 +800,10 @@ Token compute_next_token(Lexer *lexer) {
     return make_special_word(lexer);
   }
 
-  if (isdigit(previous_character)) {
+  if (is_character_class(previous_character, CHAR_DIGIT)) {
     return make_number_token(lexer);
   }
-  if (isalpha(previous_character) || previous_character == '_') {
+  if (is_character_class(previous_character, CHAR_IDENTIFIER_START)) {
     return make_identifier_token(lexer);
   }
 
@@ -250,11 +818,59 @@ Token compute_next_token(Lexer *lexer) {
     return make_token(lexer, TOKEN_LBRACE);
   case '}':
     return make_token(lexer, TOKEN_RBRACE);
+  case '[':
+    return make_token(lexer, TOKEN_LBRACKET);
+  case ']':
+    return make_token(lexer, TOKEN_RBRACKET);
+  case ':':
+    return make_token(lexer, TOKEN_COLON);
   case ';':
     return make_token(lexer, TOKEN_SEMICOLON);
   case ',':
     return make_token(lexer, TOKEN_COMMA);
+  case '+':
+    return make_token(lexer, TOKEN_PLUS);
+  case '-':
+    return make_token(lexer, TOKEN_MINUS);
+  case '*':
+    return make_token(lexer, TOKEN_STAR);
+  case '/':
+    return make_token(lexer, TOKEN_SLASH);
+  case '%':
+    return make_token(lexer, TOKEN_PERCENT);
+  case '^':
+    return make_token(lexer, TOKEN_CARET);
+  case '~':
+    return make_token(lexer, TOKEN_TILDE);
+
+  // Operators which may be followed by a second character.
+  case '&':
+    return make_token(lexer, match_character(lexer, '&') ? TOKEN_AND_AND
+                                                         : TOKEN_AMPERSAND);
+  case '|':
+    return make_token(lexer,
+                      match_character(lexer, '|') ? TOKEN_OR_OR : TOKEN_PIPE);
+  case '!':
+    return make_token(lexer, match_character(lexer, '=') ? TOKEN_BANG_EQUAL
+                                                         : TOKEN_BANG);
+  case '=':
+    return make_token(lexer, match_character(lexer, '=') ? TOKEN_EQUAL_EQUAL
+                                                         : TOKEN_EQUAL);
+  case '<':
+    if (match_character(lexer, '<')) {
+      return make_token(lexer, TOKEN_SHIFT_LEFT);
+    }
+    return make_token(lexer, match_character(lexer, '=') ? TOKEN_LESS_EQUAL
+                                                         : TOKEN_LESS);
+  case '>':
+    if (match_character(lexer, '>')) {
+      return make_token(lexer, TOKEN_SHIFT_RIGHT);
+    }
+    return make_token(lexer, match_character(lexer, '=') ? TOKEN_GREATER_EQUAL
+                                                         : TOKEN_GREATER);
   }
 
+  fprintf(stderr, "Lexer error: Unexpected character '%c' at line %zu\n",
+          previous_character, lexer->line);
   exit(1);
 };
\ No newline at end of file
@@ -0,0 +1,77 @@
+#include "include/lto.h"
+#include "llvm-c/BitReader.h"
+#include "llvm-c/Core.h"
+#include "llvm-c/Linker.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Function to link bitcode files into the program's module.
+void link_bitcode_files(LLVMModuleRef llvm_module, const char *const *paths,
+                        size_t path_count) {
+  LLVMContextRef llvm_context = LLVMGetModuleContext(llvm_module);
+  for (size_t i = 0; i < path_count; i++) {
+    LLVMMemoryBufferRef buffer = NULL;
+    char *err = NULL;
+    if (LLVMCreateMemoryBufferWithContentsOfFile(paths[i], &buffer, &err)) {
+      fprintf(stderr, "Could not open bitcode file at: %s: %s\n", paths[i],
+              err);
+      LLVMDisposeMessage(err);
+      exit(1);
+    }
+
+    LLVMModuleRef library = NULL;
+    if (LLVMParseBitcodeInContext(llvm_context, buffer, &library, &err)) {
+      fprintf(stderr, "Failed to read the bitcode of %s: %s\n", paths[i],
+              err);
+      LLVMDisposeMessage(err);
+      exit(1);
+    }
+    LLVMDisposeMemoryBuffer(buffer);
+
+    // The library is consumed by the link.
+    if (LLVMLinkModules2(llvm_module, library)) {
+      fprintf(stderr, "Failed to link %s into the program\n", paths[i]);
+      exit(1);
+    }
+  }
+}
+
+// Helper function to decide whether a global may become internal.
+static bool can_internalize(LLVMValueRef global) {
+  if (LLVMIsDeclaration(global)) {
+    return false;
+  }
+
+  // Appending globals such as llvm.used are read by the backend by name.
+  LLVMLinkage linkage = LLVMGetLinkage(global);
+  if (linkage == LLVMAppendingLinkage || linkage == LLVMInternalLinkage ||
+      linkage == LLVMPrivateLinkage) {
+    return false;
+  }
+
+  size_t length = 0;
+  const char *name = LLVMGetValueName2(global, &length);
+  return !(length == 4 && memcmp(name, "main", 4) == 0) &&
+         strncmp(name, "llvm.", 5) != 0;
+}
+
+// Function to give every definition except `main` internal linkage.
+void internalize_module(LLVMModuleRef llvm_module) {
+  for (LLVMValueRef function = LLVMGetFirstFunction(llvm_module); function;
+       function = LLVMGetNextFunction(function)) {
+    if (can_internalize(function)) {
+      LLVMSetLinkage(function, LLVMInternalLinkage);
+      LLVMSetVisibility(function, LLVMDefaultVisibility);
+    }
+  }
+
+  for (LLVMValueRef global = LLVMGetFirstGlobal(llvm_module); global;
+       global = LLVMGetNextGlobal(global)) {
+    if (can_internalize(global)) {
+      LLVMSetLinkage(global, LLVMInternalLinkage);
+      LLVMSetVisibility(global, LLVMDefaultVisibility);
+    }
+  }
+}
@@ -1,77 +1,503 @@
+#include "arena.c"
 #include "ast.c"
+#include "cache.c"
 #include "codegen.c"
+#include "emit.c"
+#include "fold.c"
+#include "frontend.c"
+#include "intern.c"
+#include "jit.c"
 #include "include/lexer.h"
 #include "lexer.c"
+#include "lto.c"
+#include "optimizer.c"
 #include "parser.c"
+#include "scan.c"
+#include "source.c"
+#include "timer.c"
+#include "tokens.c"
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-// Helper function to read a file's contents into a string.
-char *get_file_contents(const char *filepath) {
-  // Opening the file in binary read mode.
-  FILE *file = fopen(filepath, "rb");
+// Helper function to print how the compiler is invoked.
+void print_usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [run] [options] <file.fl>...\n"
+          "Options:\n"
+          "  --emit=ll|bc|asm|obj  Output format (default: ll)\n"
+          "  -o <path>             Output file (default: stdout)\n"
+          "  -O0 .. -O3            Optimization level (default: -O0)\n"
+          "  --time-passes         Print the time spent in every pass\n"
+          "  --pretokenize         Lex each file completely before parsing\n"
+          "  --jobs=N              Parse and lower on N threads\n"
+          "  --emit-per-file       Write one output per input, into the\n"
+          "                        directory given by -o\n"
+          "  --link-bc=<file.bc>   Link a bitcode library, e.g. std/ compiled\n"
+          "                        with clang -emit-llvm, and optimize the\n"
+          "                        program together with it\n"
+          "  --cache[=DIR]         Reuse the modules of unchanged files\n"
+          "                        (default: " CACHE_DEFAULT_DIRECTORY ")\n"
+          "  --stats               Print allocation and codegen statistics\n"
+          "  --time-report[=json]  Print per-phase timings and memory use\n",
+          program);
+}
 
-  // Checking if the file was opened successfully.
-  if (!file) {
-    fprintf(stderr, "Could not open file at: %s\n", filepath);
-    exit(1);
+// Helper function to derive the output path of an input file, replacing its
+// extension with the one of the output format.
+char *per_file_output_path(const char *input_path, const char *directory,
+                           EmitKind emit_kind) {
+  const char *file_name = strrchr(input_path, '/');
+  file_name = file_name ? file_name + 1 : input_path;
+
+  // Without a directory, the output is written next to the input.
+  int directory_length = directory ? (int)strlen(directory)
+                                   : (int)(file_name - input_path);
+  if (!directory) {
+    directory = input_path;
   }
 
-  // Go to the end of the file to determine its size.
-  fseek(file, 0L, SEEK_END);
-  size_t size = ftell(file);
-  rewind(file); // Go back to the start.
+  const char *extension = strrchr(file_name, '.');
+  int stem_length = extension ? (int)(extension - file_name)
+                              : (int)strlen(file_name);
 
-  // Allocating memory to hold the contents of the opened file.
-  char *buffer = (char *)malloc(size + 1);
-  if (!buffer) {
-    fprintf(stderr, "Failed to allocate memory to load the file.\n");
-    fclose(file);
+  size_t size = (size_t)directory_length + (size_t)stem_length + 16;
+  char *path = malloc(size);
+  if (!path) {
+    fprintf(stderr, "Memory allocation failed\n");
     exit(1);
   }
 
-  // Reading the file into the memory and null-terminating the buffer.
-  size_t bytes_read = fread(buffer, 1, size, file);
-  if (bytes_read < size) {
-    fprintf(stderr, "Failed to read the entire file.\n");
-    free(buffer);
-    fclose(file);
+  bool needs_separator =
+      directory_length > 0 && directory[directory_length - 1] != '/';
+  snprintf(path, size, "%.*s%s%.*s.%s", directory_length, directory,
+           needs_separator ? "/" : "", stem_length, file_name,
+           emit_extension(emit_kind));
+  return path;
+}
+
+// Helper function to lex and parse every mapped source file, on several
+// threads when asked to.
+void parse_sources(const SourceFile *sources, Ast *asts, size_t unit_count,
+                   bool pretokenize, unsigned jobs, TimeReport *time_report) {
+  if (jobs > 1 && unit_count > 1) {
+    // Every thread lexes and parses whole files.
+    time_report_begin(time_report, "frontend");
+    frontend_parse_sources(sources, unit_count, asts, pretokenize, jobs);
+    time_report_end(time_report);
+  } else {
+    for (size_t i = 0; i < unit_count; i++) {
+      frontend_parse_source(&sources[i], &asts[i], pretokenize, time_report);
+      // ast_print(&asts[i], 0, 0);
+    }
+  }
+}
+
+// Helper function to verify and optimize the modules lowered per file,
+// skipping the ones marked as already optimized.
+void optimize_modules(LLVMModuleRef *llvm_modules, const bool *optimized,
+                      size_t unit_count,
+                      const OptimizerOptions *optimizer_options,
+                      TimeReport *time_report) {
+  for (size_t i = 0; i < unit_count; i++) {
+    if (optimized && optimized[i]) {
+      continue;
+    }
+
+    time_report_begin(time_report, "verify");
+    verify_module(llvm_modules[i]);
+    time_report_end(time_report);
+
+    time_report_begin(time_report, "optimize");
+    LLVMTargetMachineRef target_machine =
+        create_host_target_machine(llvm_modules[i], optimizer_options->level);
+    optimize_module(llvm_modules[i], target_machine, optimizer_options);
+    LLVMDisposeTargetMachine(target_machine);
+    time_report_end(time_report);
+  }
+}
+
+// Helper function to write every module lowered per file on its own.
+void emit_modules_per_file(LLVMModuleRef *llvm_modules,
+                           const char *const *input_paths, size_t unit_count,
+                           unsigned optimization_level, EmitKind emit_kind,
+                           const char *output_directory,
+                           TimeReport *time_report) {
+  for (size_t i = 0; i < unit_count; i++) {
+    char *output_path =
+        per_file_output_path(input_paths[i], output_directory, emit_kind);
+    time_report_begin(time_report, "emit");
+    LLVMTargetMachineRef target_machine =
+        create_host_target_machine(llvm_modules[i], optimization_level);
+    emit_module(llvm_modules[i], target_machine, emit_kind, output_path);
+    time_report_end(time_report);
+
+    free(output_path);
+    LLVMDisposeTargetMachine(target_machine);
+    LLVMDisposeModule(llvm_modules[i]);
+  }
+}
+
+// Helper function to obtain the optimized module of every file, lowering
+// only the files whose module is not in the cache. The files are parsed
+// only when one of them misses.
+void lower_with_cache(ModuleCache *cache, const SourceFile *sources,
+                      Ast *asts, const char *const *input_paths,
+                      size_t unit_count, LLVMContextRef llvm_context,
+                      const OptimizerOptions *optimizer_options,
+                      bool pretokenize, unsigned jobs,
+                      LLVMModuleRef *llvm_modules, CodegenStats *codegen_stats,
+                      TimeReport *time_report) {
+  uint64_t *source_hashes = calloc(unit_count, sizeof(uint64_t));
+  uint64_t *keys = malloc(unit_count * sizeof(uint64_t));
+  CacheInterface *interfaces = calloc(unit_count, sizeof(CacheInterface));
+  bool *cached = calloc(unit_count, sizeof(bool));
+  if (!source_hashes || !keys || !interfaces || !cached) {
+    fprintf(stderr, "Memory allocation failed\n");
     exit(1);
   }
-  buffer[size] = '\0';
 
-  // Close the file.
-  fclose(file);
+  // The interfaces of unchanged files are known without parsing them.
+  time_report_begin(time_report, "cache");
+  size_t interfaces_known = 0;
+  for (size_t i = 0; i < unit_count; i++) {
+    source_hashes[i] = module_cache_source_hash(&sources[i]);
+    interfaces_known +=
+        module_cache_load_interface(cache, source_hashes[i], &interfaces[i]);
+  }
+  time_report_end(time_report);
+
+  // The interface of a changed file is taken from its tree.
+  bool parsed = false;
+  if (interfaces_known < unit_count) {
+    parse_sources(sources, asts, unit_count, pretokenize, jobs, time_report);
+    for (size_t i = 0; i < unit_count; i++) {
+      module_cache_interface_free(&interfaces[i]);
+      module_cache_interface_init(&interfaces[i], &asts[i]);
+      module_cache_store_interface(cache, source_hashes[i], &interfaces[i]);
+    }
+    parsed = true;
+  }
+
+  time_report_begin(time_report, "cache");
+  module_cache_keys(cache, source_hashes, interfaces, unit_count, keys);
+  size_t missing = 0;
+  for (size_t i = 0; i < unit_count; i++) {
+    llvm_modules[i] = module_cache_load(cache, keys[i], llvm_context);
+    cached[i] = llvm_modules[i] != NULL;
+    missing += !cached[i];
+  }
+  time_report_end(time_report);
+
+  // Lowering the misses, which needs the trees of every file.
+  if (missing > 0) {
+    if (!parsed) {
+      parse_sources(sources, asts, unit_count, pretokenize, jobs,
+                    time_report);
+    }
+
+    time_report_begin(time_report, "codegen");
+    codegen_per_unit(asts, input_paths, unit_count, llvm_context,
+                     llvm_modules, codegen_stats);
+    time_report_end(time_report);
+
+    optimize_modules(llvm_modules, cached, unit_count, optimizer_options,
+                     time_report);
 
-  return buffer;
+    time_report_begin(time_report, "cache");
+    for (size_t i = 0; i < unit_count; i++) {
+      if (!cached[i]) {
+        module_cache_store(cache, keys[i], llvm_modules[i]);
+      }
+    }
+    time_report_end(time_report);
+  }
+
+  cache->hits += unit_count - missing;
+  cache->misses += missing;
+
+  for (size_t i = 0; i < unit_count; i++) {
+    module_cache_interface_free(&interfaces[i]);
+  }
+  free(source_hashes);
+  free(keys);
+  free(interfaces);
+  free(cached);
 }
 
-int main() {
-  // FUTURE: Update this to read the actual file content.
-  char *source_code = get_file_contents("./testing/main.fl");
+int main(int argc, char **argv) {
+  // `run` executes the program in-process instead of emitting it.
+  bool run_program = argc > 1 && strcmp(argv[1], "run") == 0;
 
-  // Initalising the lexer.
-  Lexer *lexer = (Lexer *)(malloc(sizeof(Lexer)));
-  lexer_init(lexer, source_code);
+  // Parsing the command line flags.
+  bool print_stats = false;
+  bool pretokenize = false;
+  bool per_file = false;
+  unsigned jobs = 0;
+  OptimizerOptions optimizer_options = {.level = 0, .time_passes = false};
+  EmitKind emit_kind = EMIT_LLVM_IR;
+  const char *output_path = NULL;
+  const char *cache_directory = NULL;
+  TimeReportFormat time_report_format = TIME_REPORT_NONE;
+  Vector(const char *) input_paths;
+  vec_init(const char *, &input_paths);
+  Vector(const char *) bitcode_paths;
+  vec_init(const char *, &bitcode_paths);
+  for (int i = run_program ? 2 : 1; i < argc; i++) {
+    if (strcmp(argv[i], "--emit=ll") == 0) {
+      emit_kind = EMIT_LLVM_IR;
+    } else if (strcmp(argv[i], "--emit=bc") == 0) {
+      emit_kind = EMIT_BITCODE;
+    } else if (strcmp(argv[i], "--emit=asm") == 0) {
+      emit_kind = EMIT_ASSEMBLY;
+    } else if (strcmp(argv[i], "--emit=obj") == 0) {
+      emit_kind = EMIT_OBJECT;
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      output_path = argv[++i];
+    } else if (strcmp(argv[i], "--pretokenize") == 0) {
+      pretokenize = true;
+    } else if (strncmp(argv[i], "--jobs=", 7) == 0 &&
+               atoi(argv[i] + 7) > 0) {
+      jobs = (unsigned)atoi(argv[i] + 7);
+    } else if (strcmp(argv[i], "--emit-per-file") == 0) {
+      per_file = true;
+    } else if (strncmp(argv[i], "--link-bc=", 10) == 0 &&
+               argv[i][10] != '\0') {
+      vec_push(const char *, &bitcode_paths, argv[i] + 10);
+    } else if (strcmp(argv[i], "--cache") == 0) {
+      cache_directory = CACHE_DEFAULT_DIRECTORY;
+    } else if (strncmp(argv[i], "--cache=", 8) == 0 && argv[i][8] != '\0') {
+      cache_directory = argv[i] + 8;
+    } else if (strcmp(argv[i], "--stats") == 0) {
+      print_stats = true;
+    } else if (strcmp(argv[i], "--time-report") == 0) {
+      time_report_format = TIME_REPORT_TABLE;
+    } else if (strcmp(argv[i], "--time-report=json") == 0) {
+      time_report_format = TIME_REPORT_JSON;
+    } else if (strcmp(argv[i], "--time-passes") == 0) {
+      optimizer_options.time_passes = true;
+    } else if (strncmp(argv[i], "-O", 2) == 0 && argv[i][2] >= '0' &&
+               argv[i][2] <= '3' && argv[i][3] == '\0') {
+      optimizer_options.level = (unsigned)(argv[i][2] - '0');
+    } else if (argv[i][0] == '-') {
+      fprintf(stderr, "Unknown option: %s\n", argv[i]);
+      print_usage(argv[0]);
+      return 1;
+    } else {
+      vec_push(const char *, &input_paths, argv[i]);
+    }
+  }
 
-  // Token t = compute_next_token(lexer);
-  // while (t.kind != TOKEN_EOF) {
-  //   printf("%s\n", token_kind_to_string(t.kind));
-  //   t = compute_next_token(lexer);
-  // }
+  if (input_paths.length == 0) {
+    fprintf(stderr, "No input files.\n");
+    print_usage(argv[0]);
+    return 1;
+  }
 
-  // Initalising the parser.
-  Parser *parser = (Parser *)(malloc(sizeof(Parser)));
-  parser_init(parser, lexer);
+  if (run_program && per_file) {
+    fprintf(stderr, "--emit-per-file cannot be combined with run.\n");
+    return 1;
+  }
 
-  // Generating a translation unit
-  AstNode *translation_unit = parse_translation_unit(parser);
-  // ast_print(translation_unit, 0);
+  if (per_file && bitcode_paths.length > 0) {
+    fprintf(stderr, "--emit-per-file cannot be combined with --link-bc.\n");
+    return 1;
+  }
 
-  // Printing the program to the console.
-  const char *ir = codegen(translation_unit);
-  ast_free(translation_unit);
-  puts(ir);
+  // Initalising the per-phase timers.
+  TimeReport time_report;
+  time_report_init(&time_report);
+
+  // Initalising the string pool shared by every phase.
+  intern_init();
+
+  // Mapping every input file. The tokens point into the mappings, so they
+  // stay alive until the program has been lowered.
+  size_t unit_count = input_paths.length;
+  SourceFile *sources = malloc(unit_count * sizeof(SourceFile));
+  Ast *asts = calloc(unit_count, sizeof(Ast));
+  LLVMModuleRef *llvm_modules = calloc(unit_count, sizeof(LLVMModuleRef));
+  if (!sources || !asts || !llvm_modules) {
+    fprintf(stderr, "Memory allocation failed\n");
+    return 1;
+  }
+
+  time_report_begin(&time_report, "read");
+  for (size_t i = 0; i < unit_count; i++) {
+    source_open(&sources[i], input_paths.data[i]);
+  }
+  time_report_end(&time_report);
+
+  // The JIT requires the module to live in a thread safe context.
+  CodegenStats codegen_stats = {0};
+  LLVMOrcThreadSafeContextRef jit_context = NULL;
+  LLVMContextRef llvm_context = NULL;
+  if (run_program) {
+    jit_context = LLVMOrcCreateNewThreadSafeContext();
+    llvm_context = LLVMOrcThreadSafeContextGetContext(jit_context);
+  } else {
+    llvm_context = LLVMContextCreate();
+  }
+
+  // Lowering the program to an LLVM module and optimizing it.
+  LLVMModuleRef llvm_module = NULL;
+  LLVMTargetMachineRef target_machine = NULL;
+  bool is_linked = false; // Linked from parts which were optimized alone.
+  ModuleCache cache = {0};
+  if (cache_directory) {
+    // Every file is optimized on its own, so its module can be reused
+    // whenever the file and the signatures it calls stay the same. Calls
+    // between files are inlined once the modules are linked.
+    module_cache_init(&cache, cache_directory, optimizer_options.level);
+    lower_with_cache(&cache, sources, asts, input_paths.data, unit_count,
+                     llvm_context, &optimizer_options, pretokenize, jobs,
+                     llvm_modules, &codegen_stats, &time_report);
+  } else {
+    // Lexing and parsing every input file.
+    parse_sources(sources, asts, unit_count, pretokenize, jobs,
+                  &time_report);
+
+    if (per_file) {
+      time_report_begin(&time_report, "codegen");
+      codegen_per_unit(asts, input_paths.data, unit_count, llvm_context,
+                       llvm_modules, &codegen_stats);
+      time_report_end(&time_report);
+
+      optimize_modules(llvm_modules, NULL, unit_count, &optimizer_options,
+                       &time_report);
+    } else if (jobs > 0) {
+      // With jobs, the functions are lowered and optimized in parallel
+      // shards which are linked afterwards.
+      time_report_begin(&time_report, "codegen+opt");
+      llvm_module = codegen_parallel(asts, unit_count, llvm_context,
+                                     &optimizer_options, jobs, &codegen_stats);
+      time_report_end(&time_report);
+      is_linked = true;
+    } else {
+      time_report_begin(&time_report, "codegen");
+      llvm_module = codegen(asts, unit_count, llvm_context, &codegen_stats);
+      time_report_end(&time_report);
+
+      time_report_begin(&time_report, "verify");
+      verify_module(llvm_module);
+      time_report_end(&time_report);
+
+      time_report_begin(&time_report, "optimize");
+      target_machine =
+          create_host_target_machine(llvm_module, optimizer_options.level);
+      optimize_module(llvm_module, target_machine, &optimizer_options);
+      time_report_end(&time_report);
+    }
+  }
+
+  if (per_file) {
+    emit_modules_per_file(llvm_modules, input_paths.data, unit_count,
+                          optimizer_options.level, emit_kind, output_path,
+                          &time_report);
+  } else if (!llvm_module) {
+    // Linking the modules which were optimized per file.
+    time_report_begin(&time_report, "link");
+    link_modules(llvm_modules, unit_count);
+    llvm_module = llvm_modules[0];
+    time_report_end(&time_report);
+    is_linked = true;
+  }
+  if (!per_file && !target_machine) {
+    time_report_begin(&time_report, "verify");
+    verify_module(llvm_module);
+    time_report_end(&time_report);
+
+    target_machine =
+        create_host_target_machine(llvm_module, optimizer_options.level);
+  }
+  free(llvm_modules);
+
+  // Calls between the linked parts are only inlined once they share a
+  // module. The link-time pipeline below does so itself.
+  if (is_linked && bitcode_paths.length == 0) {
+    time_report_begin(&time_report, "optimize-linked");
+    optimize_linked_module(llvm_module, target_machine, &optimizer_options);
+    time_report_end(&time_report);
+  }
+
+  // Linking the bitcode libraries and optimizing the whole program once
+  // more, so their small functions can be inlined into FerroLang callers.
+  if (bitcode_paths.length > 0) {
+    time_report_begin(&time_report, "lto");
+    link_bitcode_files(llvm_module, bitcode_paths.data, bitcode_paths.length);
+    internalize_module(llvm_module);
+    optimize_module_lto(llvm_module, target_machine, &optimizer_options);
+    time_report_end(&time_report);
+  }
+
+  size_t source_bytes = 0;
+  AstMemory ast_memory = {0};
+  for (size_t i = 0; i < unit_count; i++) {
+    source_bytes += sources[i].size;
+    ast_memory_add(&ast_memory, &asts[i]);
+  }
+
+  if (print_stats) {
+    ast_memory_print(&ast_memory, stderr);
+    intern_print_stats(stderr);
+    codegen_print_stats(&codegen_stats, stderr);
+    if (cache_directory) {
+      module_cache_print_stats(&cache, stderr);
+    }
+  }
+  time_report_counter(&time_report, "source_bytes", source_bytes);
+  time_report_counter(&time_report, "tokens", ast_memory.token_count);
+  time_report_counter(&time_report, "ast_nodes", ast_memory.node_count);
+  time_report_counter(&time_report, "ast_bytes",
+                      ast_memory.token_bytes + ast_memory.node_bytes +
+                          ast_memory.extra_bytes);
+  time_report_counter(&time_report, "interned_strings", intern_count());
+  time_report_counter(&time_report, "string_literals",
+                      codegen_stats.string_literals);
+  time_report_counter(&time_report, "string_literal_globals",
+                      codegen_stats.unique_string_literals);
+  if (cache_directory) {
+    time_report_counter(&time_report, "cache_hits", cache.hits);
+    time_report_counter(&time_report, "cache_misses", cache.misses);
+  }
+  for (size_t i = 0; i < unit_count; i++) {
+    ast_free(&asts[i]);
+    source_close(&sources[i]);
+  }
+  free(sources);
+  free(asts);
+  vec_free(const char *, &input_paths);
+  vec_free(const char *, &bitcode_paths);
+
+  // Calling main directly, the JIT takes ownership of the module.
+  int exit_code = 0;
+  if (run_program) {
+    LLVMDisposeTargetMachine(target_machine);
+    time_report_begin(&time_report, "jit+run");
+    exit_code = jit_run_main(llvm_module, jit_context);
+    time_report_end(&time_report);
+    LLVMOrcDisposeThreadSafeContext(jit_context);
+  } else if (per_file) {
+    // Every file was already written.
+    LLVMContextDispose(llvm_context);
+  } else {
+    // Writing the program straight from the in-memory module.
+    time_report_begin(&time_report, "emit");
+    emit_module(llvm_module, target_machine, emit_kind, output_path);
+    time_report_end(&time_report);
+
+    LLVMDisposeTargetMachine(target_machine);
+    LLVMDisposeModule(llvm_module);
+    LLVMContextDispose(llvm_context);
+  }
+  intern_free();
+
+  if (time_report_format == TIME_REPORT_TABLE) {
+    time_report_print(&time_report, stderr);
+  } else if (time_report_format == TIME_REPORT_JSON) {
+    time_report_print_json(&time_report, stderr);
+  }
 
-  return 0;
+  return exit_code;
 }
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "include/optimizer.h"
+#include "llvm-c/Core.h"
+#include "llvm-c/Error.h"
+#include "llvm-c/Support.h"
+#include "llvm-c/TargetMachine.h"
+#include "llvm-c/Transforms/PassBuilder.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Helper function to enable LLVM's pass timers once per process.
+void enable_pass_timers(void) {
+  static bool enabled = false;
+  if (enabled) {
+    return;
+  }
+
+  const char *args[] = {"ferro", "-time-passes"};
+  LLVMParseCommandLineOptions(2, args, NULL);
+  enabled = true;
+}
+
+// Helper function to run a pass pipeline, tuned for the optimization level.
+void run_pipeline(LLVMModuleRef llvm_module,
+                  LLVMTargetMachineRef target_machine,
+                  const OptimizerOptions *options, const char *pipeline) {
+  if (options->time_passes) {
+    enable_pass_timers();
+  }
+
+  // Same tuning clang applies for the matching -O level.
+  LLVMPassBuilderOptionsRef pass_options = LLVMCreatePassBuilderOptions();
+  LLVMPassBuilderOptionsSetLoopUnrolling(pass_options, options->level >= 1);
+  LLVMPassBuilderOptionsSetLoopVectorization(pass_options,
+                                             options->level >= 2);
+  LLVMPassBuilderOptionsSetSLPVectorization(pass_options, options->level >= 2);
+  LLVMPassBuilderOptionsSetLoopInterleaving(pass_options, options->level >= 2);
+
+  LLVMErrorRef error =
+      LLVMRunPasses(llvm_module, pipeline, target_machine, pass_options);
+  LLVMDisposePassBuilderOptions(pass_options);
+
+  if (error) {
+    char *message = LLVMGetErrorMessage(error);
+    fprintf(stderr, "Failed to optimize the module: %s\n", message);
+    LLVMDisposeErrorMessage(message);
+    exit(1);
+  }
+}
+
+// Function to run the new pass manager pipeline over a module.
+void optimize_module(LLVMModuleRef llvm_module,
+                     LLVMTargetMachineRef target_machine,
+                     const OptimizerOptions *options) {
+  if (options->level > 3) {
+    fprintf(stderr, "Error: Unknown optimization level -O%u\n",
+            options->level);
+    exit(1);
+  }
+
+  // Codegen keeps every variable in a stack slot. The -O1 and higher
+  // pipelines promote them to registers with SROA, at -O0 mem2reg does.
+  char pipeline[64];
+  if (options->level == 0) {
+    snprintf(pipeline, sizeof(pipeline), "default<O0>,function(mem2reg)");
+  } else {
+    snprintf(pipeline, sizeof(pipeline), "default<O%u>", options->level);
+  }
+  run_pipeline(llvm_module, target_machine, options, pipeline);
+}
+
+// Function to optimize a module linked from parts which were optimized on
+// their own, so calls between the parts are inlined and simplified.
+void optimize_linked_module(LLVMModuleRef llvm_module,
+                            LLVMTargetMachineRef target_machine,
+                            const OptimizerOptions *options) {
+  // The parts are optimized already, so inlining and cleaning up after it
+  // is enough, for a fraction of the time of a second default<O>. At -O0
+  // only functions marked @inline are inlined, like in a single module.
+  const char *pipeline =
+      options->level == 0
+          ? "always-inline"
+          : "cgscc(inline),function(sroa,early-cse,instcombine,simplifycfg)";
+  run_pipeline(llvm_module, target_machine, options, pipeline);
+}
+
+// Function to run the link-time pipeline over a module holding the whole
+// program.
+void optimize_module_lto(LLVMModuleRef llvm_module,
+                         LLVMTargetMachineRef target_machine,
+                         const OptimizerOptions *options) {
+  if (options->level > 3) {
+    fprintf(stderr, "Error: Unknown optimization level -O%u\n",
+            options->level);
+    exit(1);
+  }
+
+  char pipeline[32];
+  snprintf(pipeline, sizeof(pipeline), "lto<O%u>", options->level);
+  run_pipeline(llvm_module, target_machine, options, pipeline);
+}
@@ -2,122 +2,327 @@
 #include "include/ast.h"
 #include "include/helpers.h"
 #include "include/lexer.h"
+#include "include/tokens.h"
 #include <stdbool.h>
 #include <stdio.h>
 
+// A list of children stored in Ast.extra.
+typedef struct {
+  uint32_t start;
+  uint32_t end;
+} ExtraRange;
+
+// Helper function to make sure the token at an index has been lexed.
+// Nothing is lexed past TOKEN_EOF.
+void ensure_token(Parser *parser, size_t index) {
+  TokenBuffer *tokens = &parser->ast->tokens;
+  while (tokens->count <= index && parser->lexer) {
+    if (tokens->count > 0 && tokens->kinds[tokens->count - 1] == TOKEN_EOF) {
+      return;
+    }
+    token_buffer_push(tokens, compute_next_token(parser->lexer));
+  }
+}
+
+// Helper function to obtain the kind of the current token.
+TokenKind current_kind(const Parser *parser) {
+  return (TokenKind)parser->ast->tokens.kinds[parser->current_token];
+}
+
+// Helper function to obtain the line of the current token.
+size_t current_line(const Parser *parser) {
+  return token_buffer_line(&parser->ast->tokens, parser->current_token);
+}
+
 // Helper function to advance the parser.
-Token advance_parser(Parser *parser) {
-  parser->previous_token = parser->current_token;
-  parser->current_token = compute_next_token(parser->lexer);
-  return parser->previous_token;
+// The parser stays on the TOKEN_EOF once it reaches it.
+TokenIndex advance_parser(Parser *parser) {
+  TokenIndex previous_token = parser->current_token;
+  ensure_token(parser, (size_t)previous_token + 1);
+  if ((size_t)previous_token + 1 < parser->ast->tokens.count) {
+    parser->current_token++;
+  }
+  return previous_token;
 }
 
-// Initalise the parser.
-void parser_init(Parser *parser, Lexer *lexer) {
+// Initalise the parser, lexing on demand.
+void parser_init(Parser *parser, Lexer *lexer, Ast *ast) {
   parser->lexer = lexer;
-  parser->current_token = (Token){0};
-  parser->previous_token = (Token){0};
+  parser->ast = ast;
+  parser->current_token = 0;
+  vec_init(uint32_t, &parser->scratch);
 
-  // Setting the current token in the parser.
-  advance_parser(parser);
+  // Lexing the first token.
+  ensure_token(parser, 0);
+}
+
+// Initalise the parser to read from the already filled token buffer of the
+// tree.
+void parser_init_tokens(Parser *parser, Ast *ast) {
+  if (ast->tokens.count == 0) {
+    fprintf(stderr, "Parse error: The token buffer is empty\n");
+    exit(1);
+  }
+
+  parser->lexer = NULL;
+  parser->ast = ast;
+  parser->current_token = 0;
+  vec_init(uint32_t, &parser->scratch);
+}
+
+// Release the parser's scratch space, the tree is left untouched.
+void parser_free(Parser *parser) { vec_free(uint32_t, &parser->scratch); }
+
+// Look at the kind of a token ahead without consuming anything.
+// A distance of 0 is the current token.
+TokenKind parser_peek_kind(Parser *parser, size_t distance) {
+  size_t index = (size_t)parser->current_token + distance;
+  ensure_token(parser, index);
+  if (index >= parser->ast->tokens.count) {
+    return TOKEN_EOF;
+  }
+  return (TokenKind)parser->ast->tokens.kinds[index];
 }
 
 // Helper function to check the current token.
 bool check(Parser *parser, TokenKind expected_token_kind) {
-  return parser->current_token.kind == expected_token_kind;
+  return current_kind(parser) == expected_token_kind;
 }
 
 // Helper function to check if it's a primitive type.
 bool is_primitive_type(TokenKind token_kind) {
-  switch (token_kind) {
-  case TOKEN_INT:
+  if (is_integer_type(token_kind) || is_vector_type(token_kind)) {
     return true;
+  }
+
+  switch (token_kind) {
   case TOKEN_STRING:
     return true;
   case TOKEN_VOID:
     return true;
+  case TOKEN_BOOL:
+    return true;
   default:
     return false;
   }
 }
 
 // Helper function to advance the parser with expect.
-Token advance_with_expect(Parser *parser, TokenKind expected_token_kind) {
+TokenIndex advance_with_expect(Parser *parser, TokenKind expected_token_kind) {
   if (check(parser, expected_token_kind)) {
     return advance_parser(parser);
   }
 
   fprintf(stderr, "Parse error: Expected %s but got %s at line %zu\n",
           token_kind_to_string(expected_token_kind),
-          token_kind_to_string(parser->current_token.kind),
-          parser->current_token.line);
+          token_kind_to_string(current_kind(parser)), current_line(parser));
   exit(1);
 }
 
+// Helper function to move the children pushed since scratch_top to the
+// extra data of the tree.
+ExtraRange flush_scratch(Parser *parser, size_t scratch_top) {
+  ExtraRange range = {.start = (uint32_t)parser->ast->extra.length};
+  for (size_t i = scratch_top; i < parser->scratch.length; i++) {
+    vec_push(uint32_t, &parser->ast->extra, parser->scratch.data[i]);
+  }
+  range.end = (uint32_t)parser->ast->extra.length;
+
+  parser->scratch.length = scratch_top;
+  return range;
+}
+
 // Helper function to parse a parameter.
-AstNode *parse_parameter(Parser *parser) {
+AstIndex parse_parameter(Parser *parser) {
+  // A String may be passed to C as its pointer and length, and promise
+  // that no other pointer reaches its characters.
+  uint32_t flags = 0;
+  while (check(parser, TOKEN_SIZED) || check(parser, TOKEN_NOALIAS)) {
+    flags |= check(parser, TOKEN_SIZED) ? AST_PARAMETER_SIZED
+                                        : AST_PARAMETER_NOALIAS;
+    advance_parser(parser);
+  }
+  if (flags && !check(parser, TOKEN_STRING)) {
+    fprintf(stderr,
+            "Parse error: @sized and @noalias only apply to String "
+            "parameters at line %zu\n",
+            current_line(parser));
+    exit(1);
+  }
+
   // Expect a primitive type first
-  if (!is_primitive_type(parser->current_token.kind)) {
+  if (!is_primitive_type(current_kind(parser))) {
     fprintf(stderr,
             "Parse error: Expected primitive type for parameter at line %zu\n",
-            parser->current_token.line);
+            current_line(parser));
     exit(1);
   }
 
-  Token type_token = advance_parser(parser);
+  TokenIndex type_token = advance_parser(parser);
   bool is_tail_parameter = false;
   if (check(parser, TOKEN_TAIL)) {
     is_tail_parameter = true;
     advance_with_expect(parser, TOKEN_TAIL);
   }
-  Token name_token = advance_with_expect(parser, TOKEN_IDENTIFIER);
+  advance_with_expect(parser, TOKEN_IDENTIFIER);
+
+  return ast_add_node(parser->ast, AST_PARAMETER, type_token,
+                      is_tail_parameter, flags);
+}
+
+// Helper function to parse a comma separated list of parameters up to ')'.
+ExtraRange parse_parameters(Parser *parser) {
+  size_t scratch_top = parser->scratch.length;
+  if (!check(parser, TOKEN_RPAREN)) {
+    do {
+      AstIndex param = parse_parameter(parser);
+      vec_push(uint32_t, &parser->scratch, param);
+
+      if (check(parser, TOKEN_COMMA)) {
+        advance_parser(parser); // consume ','
+      } else {
+        break;
+      }
+    } while (true);
+  }
 
-  AstNode *param_node = ast_new(AST_PARAMETER, type_token);
-  param_node->as.parameter.parameter_type = type_token;
-  param_node->as.parameter.parameter_name = name_token;
-  param_node->as.parameter.is_tail_parameter = is_tail_parameter;
+  return flush_scratch(parser, scratch_top);
+}
 
-  return param_node;
+// Binding strength of the binary operators, tightest last. Like in Rust,
+// the bitwise operators bind tighter than the comparisons, so
+// `flags & 1 == 0` needs no parentheses.
+typedef enum {
+  PRECEDENCE_NONE, // Not a binary operator.
+  PRECEDENCE_OR,
+  PRECEDENCE_AND,
+  PRECEDENCE_COMPARISON,
+  PRECEDENCE_BITWISE_OR,
+  PRECEDENCE_BITWISE_XOR,
+  PRECEDENCE_BITWISE_AND,
+  PRECEDENCE_SHIFT,
+  PRECEDENCE_SUM,
+  PRECEDENCE_PRODUCT,
+} Precedence;
+
+// Helper function to obtain the precedence of a binary operator.
+Precedence binary_precedence(TokenKind token_kind) {
+  switch (token_kind) {
+  case TOKEN_OR_OR:
+    return PRECEDENCE_OR;
+  case TOKEN_AND_AND:
+    return PRECEDENCE_AND;
+  case TOKEN_EQUAL_EQUAL:
+  case TOKEN_BANG_EQUAL:
+  case TOKEN_LESS:
+  case TOKEN_LESS_EQUAL:
+  case TOKEN_GREATER:
+  case TOKEN_GREATER_EQUAL:
+    return PRECEDENCE_COMPARISON;
+  case TOKEN_PIPE:
+    return PRECEDENCE_BITWISE_OR;
+  case TOKEN_CARET:
+    return PRECEDENCE_BITWISE_XOR;
+  case TOKEN_AMPERSAND:
+    return PRECEDENCE_BITWISE_AND;
+  case TOKEN_SHIFT_LEFT:
+  case TOKEN_SHIFT_RIGHT:
+    return PRECEDENCE_SHIFT;
+  case TOKEN_PLUS:
+  case TOKEN_MINUS:
+    return PRECEDENCE_SUM;
+  case TOKEN_STAR:
+  case TOKEN_SLASH:
+  case TOKEN_PERCENT:
+    return PRECEDENCE_PRODUCT;
+  default:
+    return PRECEDENCE_NONE;
+  }
 }
 
-// Helper function to parse expression.
-AstNode *parse_expression(Parser *parser) {
-  switch (parser->current_token.kind) {
+AstIndex parse_expression(Parser *parser);
+
+// Helper function to parse a vector type called like a function, which
+// builds a vector from one value per lane, a single value for every lane,
+// or another vector or String to convert or load.
+AstIndex parse_vector_expression(Parser *parser) {
+  TokenIndex t = advance_parser(parser);
+  advance_with_expect(parser, TOKEN_LPAREN);
+
+  size_t scratch_top = parser->scratch.length;
+  do {
+    AstIndex value = parse_expression(parser);
+    vec_push(uint32_t, &parser->scratch, value);
+
+    if (check(parser, TOKEN_COMMA)) {
+      advance_parser(parser); // consume ','
+    } else {
+      break;
+    }
+  } while (true);
+
+  advance_with_expect(parser, TOKEN_RPAREN);
+  ExtraRange values = flush_scratch(parser, scratch_top);
+  return ast_add_node(parser->ast, AST_VECTOR_EXPRESSION, t, values.start,
+                      values.end);
+}
+
+// Helper function to parse a literal, name, call, cast or parenthesised
+// expression.
+AstIndex parse_primary_expression(Parser *parser) {
+  switch (current_kind(parser)) {
   case TOKEN_INT_LITERAL: {
-    Token t = advance_parser(parser);
-    AstNode *node = ast_new(AST_INT_LITERAL_EXPRESSION, t);
-    node->as.literal.token = t;
-    return node;
+    TokenIndex t = advance_parser(parser);
+    return ast_add_node(parser->ast, AST_INT_LITERAL_EXPRESSION, t, 0, 0);
   }
   case TOKEN_STRING_LITERAL: {
-    Token t = advance_parser(parser);
-    AstNode *node = ast_new(AST_STRING_LITERAL_EXPRESSION, t);
-    node->as.string_literal.token = t;
-    return node;
+    TokenIndex t = advance_parser(parser);
+    return ast_add_node(parser->ast, AST_STRING_LITERAL_EXPRESSION, t, 0, 0);
+  }
+  case TOKEN_TRUE:
+  case TOKEN_FALSE: {
+    bool value = check(parser, TOKEN_TRUE);
+    TokenIndex t = advance_parser(parser);
+    return ast_add_node(parser->ast, AST_BOOL_LITERAL_EXPRESSION, t, value,
+                        0);
+  }
+  case TOKEN_LPAREN: {
+    // Parentheses only group, they leave no node behind.
+    advance_parser(parser);
+    AstIndex expression = parse_expression(parser);
+    advance_with_expect(parser, TOKEN_RPAREN);
+    return expression;
+  }
+  case TOKEN_INT:
+  case TOKEN_I8:
+  case TOKEN_I16:
+  case TOKEN_I32:
+  case TOKEN_I64:
+  case TOKEN_U8:
+  case TOKEN_U16:
+  case TOKEN_U32:
+  case TOKEN_U64: {
+    // An integer type called like a function converts its argument.
+    TokenIndex t = advance_parser(parser);
+    advance_with_expect(parser, TOKEN_LPAREN);
+    AstIndex operand = parse_expression(parser);
+    advance_with_expect(parser, TOKEN_RPAREN);
+    return ast_add_node(parser->ast, AST_CAST_EXPRESSION, t, operand, 0);
   }
   case TOKEN_IDENTIFIER: {
-    Token t = advance_parser(parser);
+    TokenIndex t = advance_parser(parser);
 
     // Check if this is a function call
     if (check(parser, TOKEN_LPAREN)) {
       // This is a function call
       advance_parser(parser); // consume '('
 
-      AstNode *call_node = ast_new(AST_CALL_EXPRESSION, t);
-
-      // Create callee node (identifier)
-      AstNode *callee = ast_new(AST_IDENTIFIER_EXPRESSION, t);
-      callee->as.identifier.token = t;
-      call_node->as.call_expression.callee = callee;
-
-      // Initialize arguments vector
-      vec_init(AstNode *, &call_node->as.call_expression.arguments);
-
       // Parse arguments if any
+      size_t scratch_top = parser->scratch.length;
       if (!check(parser, TOKEN_RPAREN)) {
         do {
-          AstNode *arg = parse_expression(parser);
-          vec_push(AstNode *, &call_node->as.call_expression.arguments, arg);
+          AstIndex arg = parse_expression(parser);
+          vec_push(uint32_t, &parser->scratch, arg);
 
           if (check(parser, TOKEN_COMMA)) {
             advance_parser(parser); // consume ','
@@ -128,193 +333,381 @@ AstNode *parse_expression(Parser *parser) {
       }
 
       advance_with_expect(parser, TOKEN_RPAREN);
-      return call_node;
+      ExtraRange arguments = flush_scratch(parser, scratch_top);
+      return ast_add_node(parser->ast, AST_CALL_EXPRESSION, t,
+                          arguments.start, arguments.end);
     } else {
       // This is just an identifier
-      AstNode *node = ast_new(AST_IDENTIFIER_EXPRESSION, t);
-      node->as.identifier.token = t;
-      return node;
+      return ast_add_node(parser->ast, AST_IDENTIFIER_EXPRESSION, t, 0, 0);
     }
   }
   default:
+    if (is_vector_type(current_kind(parser))) {
+      return parse_vector_expression(parser);
+    }
     break;
   }
 
   fprintf(stderr, "Parse error: Unexpected token %s at line %zu\n",
-          token_kind_to_string(parser->current_token.kind),
-          parser->current_token.line);
+          token_kind_to_string(current_kind(parser)), current_line(parser));
   exit(1);
 }
 
+// Helper function to parse the indexing and slicing of an operand, `s[i]`,
+// `s[start:end]`, `s[start:]`, `s[:end]` or `s[:]`.
+AstIndex parse_postfix_expression(Parser *parser) {
+  AstIndex operand = parse_primary_expression(parser);
+
+  while (check(parser, TOKEN_LBRACKET)) {
+    TokenIndex t = advance_parser(parser);
+    AstIndex start = AST_NONE;
+    if (!check(parser, TOKEN_COLON)) {
+      start = parse_expression(parser);
+    }
+
+    if (!check(parser, TOKEN_COLON)) {
+      advance_with_expect(parser, TOKEN_RBRACKET);
+      operand =
+          ast_add_node(parser->ast, AST_INDEX_EXPRESSION, t, operand, start);
+      continue;
+    }
+
+    advance_parser(parser); // consume ':'
+    AstIndex end = AST_NONE;
+    if (!check(parser, TOKEN_RBRACKET)) {
+      end = parse_expression(parser);
+    }
+    advance_with_expect(parser, TOKEN_RBRACKET);
+
+    uint32_t bounds = (uint32_t)parser->ast->extra.length;
+    vec_push(uint32_t, &parser->ast->extra, start);
+    vec_push(uint32_t, &parser->ast->extra, end);
+    operand =
+        ast_add_node(parser->ast, AST_SLICE_EXPRESSION, t, operand, bounds);
+  }
+
+  return operand;
+}
+
+// Helper function to parse a prefix operator and its operand, which bind
+// tighter than any binary operator.
+AstIndex parse_unary_expression(Parser *parser) {
+  switch (current_kind(parser)) {
+  case TOKEN_MINUS:
+  case TOKEN_TILDE:
+  case TOKEN_BANG: {
+    TokenIndex t = advance_parser(parser);
+    AstIndex operand = parse_unary_expression(parser);
+    return ast_add_node(parser->ast, AST_UNARY_EXPRESSION, t, operand, 0);
+  }
+  default:
+    return parse_postfix_expression(parser);
+  }
+}
+
+// Helper function to parse the binary operators binding at least as tightly
+// as min_precedence, by precedence climbing.
+AstIndex parse_binary_expression(Parser *parser, Precedence min_precedence) {
+  AstIndex lhs = parse_unary_expression(parser);
+
+  for (;;) {
+    Precedence precedence = binary_precedence(current_kind(parser));
+    if (precedence == PRECEDENCE_NONE || precedence < min_precedence) {
+      return lhs;
+    }
+
+    // Every operator is left associative, so the right operand only takes
+    // operators binding tighter than this one.
+    TokenIndex t = advance_parser(parser);
+    AstIndex rhs = parse_binary_expression(parser, precedence + 1);
+
+    // `a < b < c` does not mean what it looks like, so it is rejected.
+    if (precedence == PRECEDENCE_COMPARISON &&
+        binary_precedence(current_kind(parser)) == PRECEDENCE_COMPARISON) {
+      fprintf(stderr,
+              "Parse error: Comparisons cannot be chained, use "
+              "parentheses at line %zu\n",
+              current_line(parser));
+      exit(1);
+    }
+
+    lhs = ast_add_node(parser->ast, AST_BINARY_EXPRESSION, t, lhs, rhs);
+  }
+}
+
+// Helper function to parse expression.
+AstIndex parse_expression(Parser *parser) {
+  return parse_binary_expression(parser, PRECEDENCE_OR);
+}
+
 // Helper function to parser return statement.
-AstNode *parse_return_statement(Parser *parser) {
+AstIndex parse_return_statement(Parser *parser, TokenIndex return_token) {
   // If the next token is a semicolon, it's a bare return
   if (check(parser, TOKEN_SEMICOLON)) {
-    AstNode *node = ast_new(AST_RETURN_STATEMENT, parser->current_token);
-    node->as.return_statement.value = NULL;
     advance_with_expect(parser, TOKEN_SEMICOLON);
-    return node;
+    return ast_add_node(parser->ast, AST_RETURN_STATEMENT, return_token,
+                        AST_NONE, 0);
   }
 
   // Otherwise parse the expression
-  AstNode *expression = parse_expression(parser);
-  AstNode *node = ast_new(AST_RETURN_STATEMENT, parser->current_token);
-  node->as.return_statement.value = expression;
+  AstIndex expression = parse_expression(parser);
+  advance_with_expect(parser, TOKEN_SEMICOLON);
+  return ast_add_node(parser->ast, AST_RETURN_STATEMENT, return_token,
+                      expression, 0);
+}
+
+AstIndex parse_block(Parser *parser);
+
+// Helper function to parse a `let` binding, an assignment or an expression,
+// the statements which may also start and step a `for` loop.
+AstIndex parse_simple_statement(Parser *parser) {
+  if (check(parser, TOKEN_LET)) {
+    advance_parser(parser);
+
+    // The type may be left out when the value tells it.
+    TokenIndex type = 0;
+    if (is_primitive_type(current_kind(parser))) {
+      type = advance_parser(parser);
+    }
+    TokenIndex name = advance_with_expect(parser, TOKEN_IDENTIFIER);
+    advance_with_expect(parser, TOKEN_EQUAL);
+    AstIndex value = parse_expression(parser);
+    return ast_add_node(parser->ast, AST_LET_STATEMENT, name, value, type);
+  }
+
+  AstIndex expression = parse_expression(parser);
+  if (check(parser, TOKEN_EQUAL)) {
+    TokenIndex equal = advance_parser(parser);
+    AstIndex value = parse_expression(parser);
+    return ast_add_node(parser->ast, AST_ASSIGN_STATEMENT, equal, expression,
+                        value);
+  }
+  return expression;
+}
+
+// Helper function to parse an if statement, with its else branches.
+AstIndex parse_if_statement(Parser *parser) {
+  TokenIndex if_token = advance_with_expect(parser, TOKEN_IF);
+  advance_with_expect(parser, TOKEN_LPAREN);
+  AstIndex condition = parse_expression(parser);
+  advance_with_expect(parser, TOKEN_RPAREN);
+  AstIndex then_block = parse_block(parser);
+
+  AstIndex else_branch = AST_NONE;
+  if (check(parser, TOKEN_ELSE)) {
+    advance_parser(parser);
+    else_branch = check(parser, TOKEN_IF) ? parse_if_statement(parser)
+                                          : parse_block(parser);
+  }
+
+  uint32_t branches = (uint32_t)parser->ast->extra.length;
+  vec_push(uint32_t, &parser->ast->extra, then_block);
+  vec_push(uint32_t, &parser->ast->extra, else_branch);
+  return ast_add_node(parser->ast, AST_IF_STATEMENT, if_token, condition,
+                      branches);
+}
+
+// Helper function to parse a while loop.
+AstIndex parse_while_statement(Parser *parser) {
+  TokenIndex while_token = advance_with_expect(parser, TOKEN_WHILE);
+  advance_with_expect(parser, TOKEN_LPAREN);
+  AstIndex condition = parse_expression(parser);
+  advance_with_expect(parser, TOKEN_RPAREN);
+  AstIndex body = parse_block(parser);
+  return ast_add_node(parser->ast, AST_WHILE_STATEMENT, while_token,
+                      condition, body);
+}
+
+// Helper function to parse a C style for loop, any of whose three clauses
+// may be left out.
+AstIndex parse_for_statement(Parser *parser) {
+  TokenIndex for_token = advance_with_expect(parser, TOKEN_FOR);
+  advance_with_expect(parser, TOKEN_LPAREN);
+
+  AstIndex init = AST_NONE;
+  if (!check(parser, TOKEN_SEMICOLON)) {
+    init = parse_simple_statement(parser);
+  }
   advance_with_expect(parser, TOKEN_SEMICOLON);
-  return node;
+
+  AstIndex condition = AST_NONE;
+  if (!check(parser, TOKEN_SEMICOLON)) {
+    condition = parse_expression(parser);
+  }
+  advance_with_expect(parser, TOKEN_SEMICOLON);
+
+  AstIndex step = AST_NONE;
+  if (!check(parser, TOKEN_RPAREN)) {
+    step = parse_simple_statement(parser);
+  }
+  advance_with_expect(parser, TOKEN_RPAREN);
+  AstIndex body = parse_block(parser);
+
+  uint32_t clauses = (uint32_t)parser->ast->extra.length;
+  vec_push(uint32_t, &parser->ast->extra, init);
+  vec_push(uint32_t, &parser->ast->extra, condition);
+  vec_push(uint32_t, &parser->ast->extra, step);
+  return ast_add_node(parser->ast, AST_FOR_STATEMENT, for_token, clauses,
+                      body);
 }
 
 // Helper function to parse statement.
-AstNode *parse_statement(Parser *parser) {
-  if (check(parser, TOKEN_RETURN)) {
+AstIndex parse_statement(Parser *parser) {
+  switch (current_kind(parser)) {
+  case TOKEN_RETURN: {
     // Skip the return token.
-    advance_parser(parser);
-    return parse_return_statement(parser);
+    TokenIndex return_token = advance_parser(parser);
+    return parse_return_statement(parser, return_token);
+  }
+  case TOKEN_IF:
+    return parse_if_statement(parser);
+  case TOKEN_WHILE:
+    return parse_while_statement(parser);
+  case TOKEN_FOR:
+    return parse_for_statement(parser);
+  case TOKEN_LBRACE:
+    return parse_block(parser);
+  case TOKEN_BREAK:
+  case TOKEN_CONTINUE: {
+    AstNodeKind kind = check(parser, TOKEN_BREAK) ? AST_BREAK_STATEMENT
+                                                  : AST_CONTINUE_STATEMENT;
+    TokenIndex t = advance_parser(parser);
+    advance_with_expect(parser, TOKEN_SEMICOLON);
+    return ast_add_node(parser->ast, kind, t, 0, 0);
+  }
+  default:
+    break;
   }
 
-  // Parse expression statement
-  AstNode *expr = parse_expression(parser);
+  // Parse a binding, assignment or expression statement
+  AstIndex statement = parse_simple_statement(parser);
   advance_with_expect(parser, TOKEN_SEMICOLON);
-  return expr;
+  return statement;
 }
 
 // Helper function to parse a block.
-AstNode *parse_block(Parser *parser) {
-  advance_with_expect(parser, TOKEN_LBRACE);
-  AstNode *block_statement =
-      ast_new(AST_BLOCK_STATEMENT, parser->current_token);
-
-  // Use the helper macro instead of manual initialization
-  vec_init(AstNode *, &block_statement->as.block_statement.statements);
+AstIndex parse_block(Parser *parser) {
+  TokenIndex lbrace = advance_with_expect(parser, TOKEN_LBRACE);
 
+  size_t scratch_top = parser->scratch.length;
   while (!check(parser, TOKEN_RBRACE) && !check(parser, TOKEN_EOF)) {
-    AstNode *statement = parse_statement(parser);
-    if (statement) {
-      vec_push(AstNode *, &block_statement->as.block_statement.statements,
-               statement);
-    }
+    AstIndex statement = parse_statement(parser);
+    vec_push(uint32_t, &parser->scratch, statement);
   }
 
   advance_with_expect(parser, TOKEN_RBRACE);
-  return block_statement;
+  ExtraRange statements = flush_scratch(parser, scratch_top);
+  return ast_add_node(parser->ast, AST_BLOCK_STATEMENT, lbrace,
+                      statements.start, statements.end);
 }
 
 // Helper function to parse function declaration.
-AstNode *parse_function_declaration(Parser *parser) {
-  Token return_type = advance_parser(parser);
-  Token fn_name = advance_with_expect(parser, TOKEN_IDENTIFIER);
+AstIndex parse_function_declaration(Parser *parser) {
+  TokenIndex return_type = advance_parser(parser);
+  advance_with_expect(parser, TOKEN_IDENTIFIER);
 
   advance_with_expect(parser, TOKEN_LPAREN);
 
-  // Creating a function node.
-  AstNode *fn_node = ast_new(AST_FUNCTION_DECLARATION, return_type);
-  fn_node->as.function_declaration.return_type = return_type;
-  fn_node->as.function_declaration.fn_name = fn_name;
-
-  // Initialize parameters vector
-  vec_init(AstNode *, &fn_node->as.function_declaration.parameters);
-
   // Parse parameters if any
-  if (!check(parser, TOKEN_RPAREN)) {
-    do {
-      AstNode *param = parse_parameter(parser);
-      vec_push(AstNode *, &fn_node->as.function_declaration.parameters, param);
-
-      if (check(parser, TOKEN_COMMA)) {
-        advance_parser(parser); // consume ','
-      } else {
-        break;
-      }
-    } while (true);
-  }
-
+  ExtraRange parameters = parse_parameters(parser);
   advance_with_expect(parser, TOKEN_RPAREN);
 
   // Parsing the function block.
-  AstNode *block = parse_block(parser);
-  fn_node->as.function_declaration.block = block;
+  AstIndex block = parse_block(parser);
+
+  // The parameter range does not fit next to the block, so it is stored in
+  // the extra data as well.
+  uint32_t parameters_index = (uint32_t)parser->ast->extra.length;
+  vec_push(uint32_t, &parser->ast->extra, parameters.start);
+  vec_push(uint32_t, &parser->ast->extra, parameters.end);
 
-  return fn_node;
+  // Creating a function node.
+  return ast_add_node(parser->ast, AST_FUNCTION_DECLARATION, return_type,
+                      parameters_index, block);
 }
 
 // Helper function to parse foreign function.
-AstNode *parse_foreign_declaration(Parser *parser) {
+AstIndex parse_foreign_declaration(Parser *parser) {
   advance_with_expect(parser, TOKEN_FOREIGN);
   advance_with_expect(parser, TOKEN_LPAREN);
 
   // Parsing the source file.
-  Token source_path = advance_with_expect(parser, TOKEN_STRING_LITERAL);
+  advance_with_expect(parser, TOKEN_STRING_LITERAL);
   advance_with_expect(parser, TOKEN_COMMA);
 
   // Parse foreign symbol name.
-  Token symbol_name = advance_with_expect(parser, TOKEN_STRING_LITERAL);
+  advance_with_expect(parser, TOKEN_STRING_LITERAL);
   advance_with_expect(parser, TOKEN_RPAREN);
 
   // Return type
-  Token return_type = advance_parser(parser);
-  // Return type
-  if (!is_primitive_type(return_type.kind)) {
+  if (!is_primitive_type(current_kind(parser))) {
     fprintf(stderr,
             "Parse error: Expected primitive type for foreign function return "
             "type at line %zu\n",
-            parser->current_token.line);
+            current_line(parser));
     exit(1);
   }
+  TokenIndex return_type = advance_parser(parser);
 
-  Token fn_name = advance_with_expect(parser, TOKEN_IDENTIFIER);
-
+  advance_with_expect(parser, TOKEN_IDENTIFIER);
   advance_with_expect(parser, TOKEN_LPAREN);
-
-  // Building a AST node.
-  AstNode *node = ast_new(AST_FOREIGN_DECLARATION, return_type);
-  node->as.foreign_declaration.return_type = return_type;
-  node->as.foreign_declaration.fn_name = fn_name;
-  node->as.foreign_declaration.source_path = source_path;
-  node->as.foreign_declaration.symbol_name = symbol_name;
-
-  vec_init(AstNode *, &node->as.foreign_declaration.parameters);
-
-  if (!check(parser, TOKEN_RPAREN)) {
-    // Parse parameters
-    do {
-      AstNode *param = parse_parameter(parser);
-      vec_push(AstNode *, &node->as.foreign_declaration.parameters, param);
-      if (check(parser, TOKEN_COMMA)) {
-        advance_parser(parser);
-      } else {
-        break;
-      }
-    } while (true);
-  }
-
+  ExtraRange parameters = parse_parameters(parser);
   advance_with_expect(parser, TOKEN_RPAREN);
   advance_with_expect(parser, TOKEN_SEMICOLON);
 
-  return node;
+  // Building a AST node.
+  return ast_add_node(parser->ast, AST_FOREIGN_DECLARATION, return_type,
+                      parameters.start, parameters.end);
 }
 
 // Helper function to parse declarations.
-AstNode *parse_declarations(Parser *parser) {
+AstIndex parse_declarations(Parser *parser) {
+  // Annotations are found again through the tokens before the declaration.
+  bool has_annotations = false;
+  bool is_inline = false;
+  bool is_noinline = false;
+  while (is_function_annotation(current_kind(parser))) {
+    has_annotations = true;
+    is_inline |= check(parser, TOKEN_INLINE);
+    is_noinline |= check(parser, TOKEN_NOINLINE);
+    advance_parser(parser);
+  }
+  if (is_inline && is_noinline) {
+    fprintf(stderr,
+            "Parse error: @inline and @noinline cannot both apply to a "
+            "function at line %zu\n",
+            current_line(parser));
+    exit(1);
+  }
+
   if (check(parser, TOKEN_FOREIGN)) {
     return parse_foreign_declaration(parser);
   }
 
-  if (is_primitive_type(parser->current_token.kind)) {
+  if (is_primitive_type(current_kind(parser))) {
     return parse_function_declaration(parser);
   }
 
+  if (has_annotations) {
+    fprintf(stderr,
+            "Parse error: Expected a function declaration after the "
+            "annotations at line %zu\n",
+            current_line(parser));
+    exit(1);
+  }
+
   return parse_statement(parser);
 }
 
-// Parse translation unit.
-AstNode *parse_translation_unit(Parser *parser) {
-  AstNode *unit = ast_new(AST_TRANSLATION_UNIT, parser->current_token);
-  vec_init(AstNode *, &unit->as.translation_unit.declarations);
-
+// Generate the translation unit, node 0 of the tree.
+void parse_translation_unit(Parser *parser) {
+  size_t scratch_top = parser->scratch.length;
   while (!check(parser, TOKEN_EOF)) {
-    vec_push(AstNode *, &unit->as.translation_unit.declarations,
-             parse_declarations(parser));
+    AstIndex declaration = parse_declarations(parser);
+    vec_push(uint32_t, &parser->scratch, declaration);
   }
 
-  return unit;
-}
\ No newline at end of file
+  ExtraRange declarations = flush_scratch(parser, scratch_top);
+  parser->ast->nodes.data[0].lhs = declarations.start;
+  parser->ast->nodes.data[0].rhs = declarations.end;
+}
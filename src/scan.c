@@ -0,0 +1,196 @@
+#include "include/scan.h"
+#include <stdint.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SCAN_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SCAN_SSE2 1
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define SCAN_NEON 1
+#endif
+
+// Whole blocks are read past the terminator on purpose, see scan.h.
+#if defined(__clang__) || defined(__GNUC__)
+#define SCAN_NO_SANITIZE __attribute__((no_sanitize_address))
+#else
+#define SCAN_NO_SANITIZE
+#endif
+
+// Byte sets searched for by the kernels.
+typedef enum {
+  SCAN_LINE_END,       // '\n', '\0'
+  SCAN_STRING_SPECIAL, // '"', '\\', '\n', '\0'
+  SCAN_NOT_BLANK,      // anything but ' ', '\t', '\r'
+} ScanSet;
+
+// Helper function to test a single byte against a set.
+static inline int scan_matches(unsigned char c, ScanSet set) {
+  switch (set) {
+  case SCAN_LINE_END:
+    return c == '\n' || c == '\0';
+  case SCAN_STRING_SPECIAL:
+    return c == '"' || c == '\\' || c == '\n' || c == '\0';
+  case SCAN_NOT_BLANK:
+    return c != ' ' && c != '\t' && c != '\r';
+  }
+  return 1;
+}
+
+#if SCAN_AVX2
+#define SCAN_BLOCK 32
+
+// Helper function to build the match mask of a 32 byte block.
+static inline uint64_t scan_block_mask(const char *block, ScanSet set) {
+  __m256i bytes = _mm256_load_si256((const __m256i *)block);
+  __m256i matches;
+  switch (set) {
+  case SCAN_LINE_END:
+    matches = _mm256_or_si256(
+        _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n')),
+        _mm256_cmpeq_epi8(bytes, _mm256_setzero_si256()));
+    break;
+  case SCAN_STRING_SPECIAL:
+    matches = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('"')),
+                        _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\\'))),
+        _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n')),
+                        _mm256_cmpeq_epi8(bytes, _mm256_setzero_si256())));
+    break;
+  default: {
+    __m256i blanks = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' ')),
+                        _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\t'))),
+        _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\r')));
+    return ~(uint64_t)(uint32_t)_mm256_movemask_epi8(blanks) & 0xffffffffu;
+  }
+  }
+  return (uint32_t)_mm256_movemask_epi8(matches);
+}
+
+#elif SCAN_SSE2
+#define SCAN_BLOCK 16
+
+// Helper function to build the match mask of a 16 byte block.
+static inline uint64_t scan_block_mask(const char *block, ScanSet set) {
+  __m128i bytes = _mm_load_si128((const __m128i *)block);
+  __m128i matches;
+  switch (set) {
+  case SCAN_LINE_END:
+    matches = _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n')),
+                           _mm_cmpeq_epi8(bytes, _mm_setzero_si128()));
+    break;
+  case SCAN_STRING_SPECIAL:
+    matches = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('"')),
+                     _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\\'))),
+        _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n')),
+                     _mm_cmpeq_epi8(bytes, _mm_setzero_si128())));
+    break;
+  default: {
+    __m128i blanks =
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')),
+                                  _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\t'))),
+                     _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\r')));
+    return ~(uint64_t)_mm_movemask_epi8(blanks) & 0xffffu;
+  }
+  }
+  return (uint64_t)_mm_movemask_epi8(matches);
+}
+
+#elif SCAN_NEON
+#define SCAN_BLOCK 16
+
+// Helper function to build the match mask of a 16 byte block.
+// NEON has no movemask, so every byte contributes four bits instead of one.
+static inline uint64_t scan_block_mask(const char *block, ScanSet set) {
+  uint8x16_t bytes = vld1q_u8((const uint8_t *)block);
+  uint8x16_t matches;
+  switch (set) {
+  case SCAN_LINE_END:
+    matches = vorrq_u8(vceqq_u8(bytes, vdupq_n_u8('\n')),
+                       vceqq_u8(bytes, vdupq_n_u8(0)));
+    break;
+  case SCAN_STRING_SPECIAL:
+    matches = vorrq_u8(vorrq_u8(vceqq_u8(bytes, vdupq_n_u8('"')),
+                                vceqq_u8(bytes, vdupq_n_u8('\\'))),
+                       vorrq_u8(vceqq_u8(bytes, vdupq_n_u8('\n')),
+                                vceqq_u8(bytes, vdupq_n_u8(0))));
+    break;
+  default:
+    matches = vmvnq_u8(vorrq_u8(vorrq_u8(vceqq_u8(bytes, vdupq_n_u8(' ')),
+                                         vceqq_u8(bytes, vdupq_n_u8('\t'))),
+                                vceqq_u8(bytes, vdupq_n_u8('\r'))));
+    break;
+  }
+  uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(matches), 4);
+  return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+}
+#endif
+
+#ifdef SCAN_BLOCK
+#if SCAN_NEON
+#define SCAN_BITS_PER_BYTE 4
+#else
+#define SCAN_BITS_PER_BYTE 1
+#endif
+
+// Helper function to find the first byte of a set, one block at a time.
+SCAN_NO_SANITIZE static const char *scan_for(const char *ptr, ScanSet set) {
+  // Loading the aligned block holding the pointer and ignoring the bytes in
+  // front of it.
+  uintptr_t offset = (uintptr_t)ptr & (SCAN_BLOCK - 1);
+  const char *block = ptr - offset;
+  uint64_t mask = scan_block_mask(block, set) >> (offset * SCAN_BITS_PER_BYTE);
+  if (mask) {
+    return ptr + __builtin_ctzll(mask) / SCAN_BITS_PER_BYTE;
+  }
+
+  for (;;) {
+    block += SCAN_BLOCK;
+    mask = scan_block_mask(block, set);
+    if (mask) {
+      return block + __builtin_ctzll(mask) / SCAN_BITS_PER_BYTE;
+    }
+  }
+}
+
+#else
+
+// Helper function to find the first byte of a set, one byte at a time.
+static const char *scan_for(const char *ptr, ScanSet set) {
+  while (!scan_matches((unsigned char)*ptr, set)) {
+    ptr++;
+  }
+  return ptr;
+}
+#endif
+
+// Function to find the first '\n' or '\0' at or after the pointer.
+const char *scan_line_end(const char *ptr) {
+  return scan_for(ptr, SCAN_LINE_END);
+}
+
+// Function to find the first '"', '\\', '\n' or '\0' at or after the pointer.
+const char *scan_string_special(const char *ptr) {
+  // Short runs are common, so the first bytes are checked directly.
+  if (scan_matches((unsigned char)*ptr, SCAN_STRING_SPECIAL)) {
+    return ptr;
+  }
+  return scan_for(ptr, SCAN_STRING_SPECIAL);
+}
+
+// Function to find the first byte which is not ' ', '\t' or '\r' at or after
+// the pointer.
+const char *scan_blanks_end(const char *ptr) {
+  // Most runs of blanks are a single space between two tokens.
+  if (scan_matches((unsigned char)*ptr, SCAN_NOT_BLANK)) {
+    return ptr;
+  }
+  if (scan_matches((unsigned char)ptr[1], SCAN_NOT_BLANK)) {
+    return ptr + 1;
+  }
+  return scan_for(ptr, SCAN_NOT_BLANK);
+}
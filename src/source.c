@@ -0,0 +1,73 @@
+#include "include/source.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Function to map a source file into memory.
+void source_open(SourceFile *source, const char *path) {
+  // Opening the file in read only mode.
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Could not open file at: %s\n", path);
+    exit(1);
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    fprintf(stderr, "Could not read the size of: %s\n", path);
+    close(fd);
+    exit(1);
+  }
+
+  source->path = path;
+  source->size = (size_t)file_stat.st_size;
+
+  // Empty files have nothing to map.
+  if (source->size == 0) {
+    source->contents = "";
+    source->mapped_size = 0;
+    close(fd);
+    return;
+  }
+
+  // Reserving at least one zeroed byte past the end of the file, which the
+  // lexer relies on as its terminator. The file is then mapped over the
+  // start of the reservation, the rest of its last page is zero-filled.
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  source->mapped_size = (source->size / page_size + 1) * page_size;
+
+  void *reservation = mmap(NULL, source->mapped_size, PROT_READ,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (reservation == MAP_FAILED) {
+    fprintf(stderr, "Failed to reserve memory to map: %s\n", path);
+    close(fd);
+    exit(1);
+  }
+
+  void *mapping = mmap(reservation, source->size, PROT_READ,
+                       MAP_PRIVATE | MAP_FIXED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    fprintf(stderr, "Failed to map file: %s\n", path);
+    munmap(reservation, source->mapped_size);
+    exit(1);
+  }
+
+  // The lexer reads the file front to back exactly once.
+  madvise(mapping, source->size, MADV_SEQUENTIAL);
+  source->contents = (const char *)mapping;
+}
+
+// Function to release the mapping of a source file.
+void source_close(SourceFile *source) {
+  if (source->mapped_size > 0) {
+    munmap((void *)source->contents, source->mapped_size);
+  }
+
+  source->contents = NULL;
+  source->size = 0;
+  source->mapped_size = 0;
+}
@@ -0,0 +1,140 @@
+#include "include/timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+// Helper function to read a clock in seconds.
+static double read_clock(clockid_t clock) {
+  struct timespec now;
+  clock_gettime(clock, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+// Helper function to read the peak resident set size of the process.
+static size_t read_peak_rss(void) {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+
+#ifdef __APPLE__
+  return (size_t)usage.ru_maxrss; // Already in bytes.
+#else
+  return (size_t)usage.ru_maxrss * 1024; // Reported in kilobytes.
+#endif
+}
+
+// Function to initialise the time report.
+void time_report_init(TimeReport *report) {
+  memset(report, 0, sizeof(*report));
+}
+
+// Function to start measuring a phase.
+void time_report_begin(TimeReport *report, const char *phase) {
+  if (!report) {
+    return;
+  }
+
+  // Phases which run more than once (e.g. once per file) are summed.
+  PhaseTiming *timing = NULL;
+  for (size_t i = 0; i < report->phase_count; i++) {
+    if (strcmp(report->phases[i].name, phase) == 0) {
+      timing = &report->phases[i];
+      break;
+    }
+  }
+
+  if (!timing) {
+    if (report->phase_count == TIME_REPORT_MAX_PHASES) {
+      fprintf(stderr, "Error: Too many phases in the time report.\n");
+      exit(1);
+    }
+    timing = &report->phases[report->phase_count++];
+    timing->name = phase;
+  }
+
+  report->current = timing;
+  report->current_wall_start = read_clock(CLOCK_MONOTONIC);
+  report->current_cpu_start = read_clock(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+// Function to stop measuring the current phase.
+void time_report_end(TimeReport *report) {
+  PhaseTiming *timing = report ? report->current : NULL;
+  if (!timing) {
+    return;
+  }
+
+  timing->wall_seconds +=
+      read_clock(CLOCK_MONOTONIC) - report->current_wall_start;
+  timing->cpu_seconds +=
+      read_clock(CLOCK_PROCESS_CPUTIME_ID) - report->current_cpu_start;
+  timing->peak_rss_bytes = read_peak_rss();
+  report->current = NULL;
+}
+
+// Function to record a counter, replacing an earlier value of the same name.
+void time_report_counter(TimeReport *report, const char *name, size_t value) {
+  for (size_t i = 0; i < report->counter_count; i++) {
+    if (strcmp(report->counters[i].name, name) == 0) {
+      report->counters[i].value = value;
+      return;
+    }
+  }
+
+  if (report->counter_count == TIME_REPORT_MAX_COUNTERS) {
+    fprintf(stderr, "Error: Too many counters in the time report.\n");
+    exit(1);
+  }
+  report->counters[report->counter_count++] =
+      (ReportCounter){.name = name, .value = value};
+}
+
+// Function to print the report as a human-readable table.
+void time_report_print(const TimeReport *report, FILE *stream) {
+  double total_wall = 0;
+  double total_cpu = 0;
+  for (size_t i = 0; i < report->phase_count; i++) {
+    total_wall += report->phases[i].wall_seconds;
+    total_cpu += report->phases[i].cpu_seconds;
+  }
+
+  fprintf(stream, "%-12s %12s %8s %12s %14s\n", "phase", "wall (ms)", "wall %",
+          "cpu (ms)", "peak rss (KiB)");
+  for (size_t i = 0; i < report->phase_count; i++) {
+    const PhaseTiming *timing = &report->phases[i];
+    fprintf(stream, "%-12s %12.3f %7.1f%% %12.3f %14zu\n", timing->name,
+            timing->wall_seconds * 1e3,
+            total_wall > 0 ? timing->wall_seconds / total_wall * 100 : 0.0,
+            timing->cpu_seconds * 1e3, timing->peak_rss_bytes / 1024);
+  }
+  fprintf(stream, "%-12s %12.3f %7.1f%% %12.3f\n", "total", total_wall * 1e3,
+          100.0, total_cpu * 1e3);
+
+  for (size_t i = 0; i < report->counter_count; i++) {
+    fprintf(stream, "%-24s %12zu\n", report->counters[i].name,
+            report->counters[i].value);
+  }
+}
+
+// Function to print the report as JSON.
+void time_report_print_json(const TimeReport *report, FILE *stream) {
+  fprintf(stream, "{\"phases\":[");
+  for (size_t i = 0; i < report->phase_count; i++) {
+    const PhaseTiming *timing = &report->phases[i];
+    fprintf(stream,
+            "%s{\"name\":\"%s\",\"wall_ms\":%.3f,\"cpu_ms\":%.3f,"
+            "\"peak_rss_bytes\":%zu}",
+            i == 0 ? "" : ",", timing->name, timing->wall_seconds * 1e3,
+            timing->cpu_seconds * 1e3, timing->peak_rss_bytes);
+  }
+
+  fprintf(stream, "],\"counters\":{");
+  for (size_t i = 0; i < report->counter_count; i++) {
+    fprintf(stream, "%s\"%s\":%zu", i == 0 ? "" : ",",
+            report->counters[i].name, report->counters[i].value);
+  }
+  fprintf(stream, "}}\n");
+}
@@ -0,0 +1,182 @@
+#include "include/tokens.h"
+#include "include/scan.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Roughly one token per this many source bytes, used to size the buffer.
+#define TOKEN_BUFFER_BYTES_PER_TOKEN 6
+
+// Roughly one line per this many source bytes, used to size the line table.
+#define TOKEN_BUFFER_BYTES_PER_LINE 32
+
+// The line of every this many tokens is kept to narrow the line search.
+#define TOKEN_BUFFER_TOKENS_PER_CHECKPOINT 64
+
+// Helper function to resize a single array of the buffer.
+static void *token_buffer_resize_array(void *data, size_t element_size,
+                                       size_t capacity) {
+  void *new_data = realloc(data, element_size * capacity);
+  if (!new_data) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(1);
+  }
+  return new_data;
+}
+
+// Helper function to resize every array of the buffer at once.
+static void token_buffer_reserve(TokenBuffer *buffer, size_t capacity) {
+  buffer->kinds =
+      token_buffer_resize_array(buffer->kinds, sizeof(uint8_t), capacity);
+  buffer->offsets =
+      token_buffer_resize_array(buffer->offsets, sizeof(uint32_t), capacity);
+  buffer->intern_ids =
+      token_buffer_resize_array(buffer->intern_ids, sizeof(InternId), capacity);
+  buffer->line_checkpoints = token_buffer_resize_array(
+      buffer->line_checkpoints, sizeof(uint32_t),
+      capacity / TOKEN_BUFFER_TOKENS_PER_CHECKPOINT + 1);
+  buffer->capacity = capacity;
+}
+
+// Helper function to record where every line of the source starts.
+static void token_buffer_index_lines(TokenBuffer *buffer, size_t source_size) {
+  size_t capacity = source_size / TOKEN_BUFFER_BYTES_PER_LINE + 16;
+  buffer->line_starts =
+      token_buffer_resize_array(NULL, sizeof(uint32_t), capacity);
+  buffer->line_starts[0] = 0;
+  buffer->line_count = 1;
+
+  const char *end = buffer->source + source_size;
+  for (const char *ptr = scan_line_end(buffer->source); ptr < end;
+       ptr = scan_line_end(ptr + 1)) {
+    // A '\0' inside the source ends the scan like the lexer does.
+    if (*ptr == '\0') {
+      break;
+    }
+
+    if (buffer->line_count == capacity) {
+      capacity *= 2;
+      buffer->line_starts = token_buffer_resize_array(
+          buffer->line_starts, sizeof(uint32_t), capacity);
+    }
+    buffer->line_starts[buffer->line_count++] =
+        (uint32_t)(ptr + 1 - buffer->source);
+  }
+
+  // The table does not grow after this, so it is trimmed to size.
+  buffer->line_starts = token_buffer_resize_array(
+      buffer->line_starts, sizeof(uint32_t), buffer->line_count);
+}
+
+// Function to initialise the token buffer, reserving space for a source of
+// the given size.
+void token_buffer_init(TokenBuffer *buffer, const char *source,
+                       size_t source_size) {
+  // Offsets and lengths are stored in 32 bits.
+  if (source_size > UINT32_MAX) {
+    fprintf(stderr, "Source files larger than 4 GiB are not supported\n");
+    exit(1);
+  }
+
+  *buffer = (TokenBuffer){.source = source};
+  token_buffer_reserve(buffer,
+                       source_size / TOKEN_BUFFER_BYTES_PER_TOKEN + 16);
+  token_buffer_index_lines(buffer, source_size);
+}
+
+// Function to append a token.
+void token_buffer_push(TokenBuffer *buffer, Token token) {
+  if (buffer->count == buffer->capacity) {
+    token_buffer_reserve(buffer, buffer->capacity * 2);
+  }
+
+  size_t index = buffer->count++;
+  buffer->kinds[index] = (uint8_t)token.kind;
+  buffer->offsets[index] = (uint32_t)(token.start_ptr - buffer->source);
+  buffer->intern_ids[index] = token_has_intern_id(token.kind)
+                                  ? token.intern_id
+                                  : (InternId)token.length;
+  if (index % TOKEN_BUFFER_TOKENS_PER_CHECKPOINT == 0) {
+    buffer->line_checkpoints[index / TOKEN_BUFFER_TOKENS_PER_CHECKPOINT] =
+        (uint32_t)(token.line - 1);
+  }
+}
+
+// Function to lex the remaining source up to and including TOKEN_EOF.
+void token_buffer_fill(TokenBuffer *buffer, Lexer *lexer) {
+  for (;;) {
+    Token token = compute_next_token(lexer);
+    token_buffer_push(buffer, token);
+    if (token.kind == TOKEN_EOF) {
+      return;
+    }
+  }
+}
+
+// Function to obtain the line of the token at an index.
+size_t token_buffer_line(const TokenBuffer *buffer, size_t index) {
+  if (index >= buffer->count) {
+    index = buffer->count - 1;
+  }
+
+  // Finding the last line which starts at or before the token, between the
+  // lines of the checkpoints on either side of it.
+  size_t checkpoint = index / TOKEN_BUFFER_TOKENS_PER_CHECKPOINT;
+  size_t next_checkpoint =
+      (checkpoint + 1) * TOKEN_BUFFER_TOKENS_PER_CHECKPOINT;
+  uint32_t offset = buffer->offsets[index];
+  size_t low = buffer->line_checkpoints[checkpoint];
+  size_t high = next_checkpoint < buffer->count
+                    ? buffer->line_checkpoints[checkpoint + 1] + (size_t)1
+                    : buffer->line_count;
+  while (high - low > 1) {
+    size_t middle = low + (high - low) / 2;
+    if (buffer->line_starts[middle] <= offset) {
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+  return low + 1;
+}
+
+// Function to rebuild the token at an index.
+// Indices past the end yield the final TOKEN_EOF.
+Token token_buffer_get(const TokenBuffer *buffer, size_t index) {
+  if (index >= buffer->count) {
+    index = buffer->count - 1;
+  }
+
+  Token token = {
+      .kind = (TokenKind)buffer->kinds[index],
+      .line = token_buffer_line(buffer, index),
+      .start_ptr = buffer->source + buffer->offsets[index],
+  };
+  if (token_has_intern_id(token.kind)) {
+    token.intern_id = buffer->intern_ids[index];
+    token.length = lexer_token_length(token.kind, token.start_ptr);
+  } else {
+    token.length = buffer->intern_ids[index];
+  }
+
+  return token;
+}
+
+// Function to obtain the bytes held by the arrays of the buffer, counting
+// either the tokens in use or every reserved slot.
+size_t token_buffer_bytes(const TokenBuffer *buffer, bool reserved) {
+  size_t count = reserved ? buffer->capacity : buffer->count;
+  size_t checkpoint_count = count / TOKEN_BUFFER_TOKENS_PER_CHECKPOINT + 1;
+  return count * (sizeof(uint8_t) + sizeof(uint32_t) + sizeof(InternId)) +
+         checkpoint_count * sizeof(uint32_t) +
+         buffer->line_count * sizeof(uint32_t);
+}
+
+// Function to release the arrays of the token buffer.
+void token_buffer_free(TokenBuffer *buffer) {
+  free(buffer->kinds);
+  free(buffer->offsets);
+  free(buffer->intern_ids);
+  free(buffer->line_starts);
+  free(buffer->line_checkpoints);
+  *buffer = (TokenBuffer){0};
+}
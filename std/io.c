@@ -4,4 +4,10 @@
 void println_c(char *msg) {
   // Printing to the console.
   printf("%s\n", msg);
-}
\ No newline at end of file
+}
+
+// Defining a function to print a @sized String, which needs no terminator.
+void print_c(const char *data, size_t length) {
+  // Writing the characters as they are.
+  fwrite(data, 1, length, stdout);
+}